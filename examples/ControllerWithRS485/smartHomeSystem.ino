@@ -31,6 +31,7 @@ RS485 rs485(RS485_SERIAL, 4, 20); // работаем по RS-485 через Ser
 // хранилище
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 Storage storage; // хранилище данных, где будет хранитьcя всякую служебную информацию (его использование обязательно!)
+// CachedStorage cachedStorage(storage); // RAM-кэш с фоновой записью поверх EEPROM (src/storage/cachedstorage.h), можно отдать ядру вместо storage
 
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // кнопка регистрации и светодиод регистрации
@@ -45,6 +46,8 @@ trigger regTrigger; // триггер, который мы будем испол
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------  
 SmartController controller(1234ul,"Теплица",storage); // идентификатор контроллера, имя контроллера, хранилище
 StreamListener controllerCommands(Serial); // обработчик команд из Serial
+// char commandsBuffer[256]; StreamListener controllerCommands(Serial,commandsBuffer,sizeof(commandsBuffer)); // то же, но с буфером команд своего размера
+// в тот же Serial можно слать и кадры двоичного протокола (src/controller/binaryprotocol.h) - они распознаются сами, но должны целиком влезать в буфер команд
   
 
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
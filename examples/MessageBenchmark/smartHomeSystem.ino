@@ -0,0 +1,183 @@
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ВСЯКИЕ ГЛОБАЛЬНЫЕ НАСТРОЙКИ ЯДРА - В ФАЙЛЕ src/config.h !!!
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// МИКРОБЕНЧМАРК СЛОЯ СООБЩЕНИЙ: замеряет время (нс на операцию) и кол-во выделений памяти на операцию
+// для фабрик сообщений, разбора сообщений и чтения полезной нагрузки. Результаты выводятся в Serial
+// один раз при старте. Для честных цифр отладочный режим в src/config.h лучше выключить, а подсчёт
+// выделений памяти (COUNT_ALLOCATIONS) - включить.
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// настройки прошивки
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+#define SERIAL_SPEED 57600 // скорость работы Serial
+#define BENCH_ITERATIONS 1000 // сколько раз повторяется каждая операция
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "src/core.h" // подключаем ядро
+#include "src/message/message.h" // сообщения - то, что меряем
+#include "src/data/anydata.h" // виртуальные данные для сообщений со слотами
+
+#include "src/utils/allocations.h" // счётчик выделений памяти слоя сообщений
+
+#ifndef COUNT_ALLOCATIONS
+  #error "MessageBenchmark counts allocations: uncomment COUNT_ALLOCATIONS in src/config.h!"
+#endif
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// наши переменные
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+const uint32_t controllerID = 1234ul;
+
+AnyData temperature(DataType::Temperature,1); // слот, данные которого гоняем в сообщениях
+
+volatile uint32_t sink = 0; // сюда складываем результаты, чтобы компилятор не выбросил замеряемый код
+
+uint32_t benchStartedAt, benchAllocations;
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void benchStart()
+{
+  allocationsCount = 0;
+  benchStartedAt = micros();
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void benchEnd(const __FlashStringHelper* name, uint16_t opsPerIteration = 1)
+{
+  uint32_t elapsed = micros() - benchStartedAt;
+  uint32_t ops = uint32_t(BENCH_ITERATIONS)*opsPerIteration;
+
+  Serial << name << F(": ") << uint32_t((uint64_t(elapsed)*1000ull)/ops) << F(" ns/op, ");
+  Serial << (allocationsCount/ops) << F(".") << ((allocationsCount%ops)*10/ops) << F(" allocs/op") << ENDLINE;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// разбор сообщения и типичная для контроллера/модуля реакция на него - чтение полей нагрузки
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void dispatch(const Message& m)
+{
+  switch(m.type)
+  {
+    case Messages::Scan:
+    case Messages::Pong:
+      sink += m.moduleID;
+    break;
+
+    case Messages::ScanResponse:
+    {
+      uint8_t nameLen = m.get<uint8_t>(0);
+      sink += nameLen + m.get<uint8_t>(1+nameLen) + m.get<uint8_t>(2+nameLen);
+    }
+    break;
+
+    case Messages::BroadcastSlotData:
+      sink += m.get<uint16_t>(0) + m.get<uint8_t>(2);
+    break;
+
+    case Messages::EventResponse:
+      sink += m.get<uint8_t>(0);
+    break;
+
+    default:
+    break;
+  }
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void runBenchmarks()
+{
+  Serial << F("Message benchmark, iterations: ") << BENCH_ITERATIONS << ENDLINE;
+
+  // фабрики сообщений
+  benchStart();
+  for(uint16_t i=0;i<BENCH_ITERATIONS;i++)
+  {
+    Message m = Message::Scan(controllerID, i);
+    sink += m.getPayloadLength();
+  }
+  benchEnd(F("Message::Scan"));
+
+  benchStart();
+  for(uint16_t i=0;i<BENCH_ITERATIONS;i++)
+  {
+    Message m = Message::ScanResponse(controllerID, i, "датчики", 1, 1);
+    sink += m.getPayloadLength();
+  }
+  benchEnd(F("Message::ScanResponse"));
+
+  benchStart();
+  for(uint16_t i=0;i<BENCH_ITERATIONS;i++)
+  {
+    Message m = Message::BroadcastSlotData(controllerID, i, &temperature);
+    sink += m.getPayloadLength();
+  }
+  benchEnd(F("Message::BroadcastSlotData"));
+
+  benchStart();
+  for(uint16_t i=0;i<BENCH_ITERATIONS;i++)
+  {
+    Event* e = Event::SlotDataChanged(i, &temperature);
+    sink += e->getDataLength();
+    delete e;
+  }
+  benchEnd(F("Event::SlotDataChanged"));
+
+  // типичная смесь входящих фреймов на шине
+  Event* e = Event::SlotDataChanged(1, &temperature);
+
+  Message mix[] =
+  {
+    Message::Scan(controllerID, 1),
+    Message::ScanResponse(controllerID, 1, "датчики", 1, 1),
+    Message::Pong(controllerID, 1),
+    Message::BroadcastSlotData(controllerID, 1, &temperature),
+    Message::EventResponse(controllerID, 1, 1, e),
+  };
+  const uint8_t mixCount = sizeof(mix)/sizeof(mix[0]);
+
+  delete e;
+
+  // чтение нагрузки из уже разобранного сообщения
+  benchStart();
+  for(uint16_t i=0;i<BENCH_ITERATIONS;i++)
+  {
+    sink += mix[1].get<uint8_t>(0) + mix[3].get<uint16_t>(0);
+  }
+  benchEnd(F("Message::get<T>()"), 2);
+
+  // разбор сырых данных
+  benchStart();
+  for(uint16_t i=0;i<BENCH_ITERATIONS;i++)
+  {
+    for(uint8_t k=0;k<mixCount;k++)
+    {
+      Message m = Message::parse(mix[k].getPayload(), mix[k].getPayloadLength());
+      sink += m.moduleID;
+    }
+  }
+  benchEnd(F("Message::parse (mix)"), mixCount);
+
+  // разбор + реакция
+  benchStart();
+  for(uint16_t i=0;i<BENCH_ITERATIONS;i++)
+  {
+    for(uint8_t k=0;k<mixCount;k++)
+    {
+      dispatch(Message::parse(mix[k].getPayload(), mix[k].getPayloadLength()));
+    }
+  }
+  benchEnd(F("parse + dispatch (mix)"), mixCount);
+
+  Serial << F("Done.") << ENDLINE;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void setup()
+{
+  Serial.begin(SERIAL_SPEED);
+
+  Temperature t{23,50};
+  temperature.set(t);
+
+  runBenchmarks();
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void loop()
+{
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
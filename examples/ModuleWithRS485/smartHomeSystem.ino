@@ -24,10 +24,31 @@
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 RS485 rs485(RS485_SERIAL, 4, 20); // работаем по RS-485 через Serial, пин переключения приема-передачи - 4, 20 миллисекунд на таймаут чтения входящих данных
 
+/*
+  Если loop() может надолго занимать (например, запись в EEPROM), 64 байт буфера Serial не хватает, и входящие байты теряются.
+  Тогда можно принимать в свой большой кольцевой буфер, который наполняется из прерывания (нужен #include "src/transport/rxring.h"):
+
+  uint8_t rxBuffer[512]; // размер - степень двойки
+  RxRing rxRing(rxBuffer,sizeof(rxBuffer));
+  RS485 rs485(rxRing, RS485_SERIAL, 4, 20); // приём - из кольцевого буфера, передача - через RS485_SERIAL
+
+  // прерывание по сравнению таймера 0 (таймер millis()) - срабатывает раз в миллисекунду, независимо от того, чем занят loop()
+  ISR(TIMER0_COMPA_vect)
+  {
+    rxRing.fill(RS485_SERIAL);
+  }
+
+  и в setup(), после RS485_SERIAL.begin():
+
+  OCR0A = 0xAF;
+  TIMSK0 |= _BV(OCIE0A);
+*/
+
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // хранилище
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 Storage storage; // хранилище данных, где будет хранитьcя всякую служебную информацию (его использование обязательно!)
+// CachedStorage cachedStorage(storage); // RAM-кэш с фоновой записью поверх EEPROM (src/storage/cachedstorage.h), можно отдать ядру вместо storage
 
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // кнопка регистрации и светодиод регистрации
@@ -80,6 +101,12 @@ void registration(bool result) // событие "результат регис
    */
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void configuration(uint8_t slotNumber) // событие "контроллер изменил слот конфигурации"
+{
+  DBG(F("CONFIGURATION SLOT CHANGED: #"));
+  DBGLN(slotNumber);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void setup()
 {
   
@@ -107,6 +134,19 @@ void setup()
   // и если в течение 30 секунд данные не приходят с контроллера - то показания сбросятся в вид "нет данных"
   module.observe(remoteFlag,5000ul,30000ul); 
 
+  // слоты конфигурации модуля хранятся в хранилище, контроллер читает их при старте и отдаёт из своего кэша:
+  // GET=CONFIG|1 - все слоты модуля #1, SET=CONFIG|1|0|5000 - сохранить в слот #0 значение 5000.
+  // Слоты добавляются до module.begin(), всегда в одном и том же порядке.
+  // module.addConfigSlot("period",ConfigSlotType::Number,4); // имя слота, тип, максимальная длина данных (слот #0)
+  // int32_t period; if(module.getConfig(0,period)) { ... } // прочитать сохранённое значение
+
+  // локальные правила модуля (формат - src/rules/rules.h) срабатывают сразу, как только модуль услышал на шине данные слота
+  // из условия, без опроса контроллером. Например, защита от сухого хода: если уровень воды (слот #7, байт) меньше 10 -
+  // записать 0 в наш наблюдаемый слот remoteFlag (#2), иначе - ничего не писать (RULE_VALUE_NONE):
+  // const uint8_t dryRun[] = { 2,0, uint8_t(DataType::Byte), 0,0,0,0, 0,0,0,0x80,
+  //   uint8_t(RuleOp::Slot),7,0, uint8_t(RuleOp::Number),10,0,0,0, uint8_t(RuleOp::Less) };
+  // module.addRule(0,dryRun,sizeof(dryRun)); // после этого remoteFlag.triggered() сработает в том же проходе loop()
+
   module.begin(); // модуль готов к работе, стартуем его
 
   // можем при старте принудительно привязать модуль к контроллеру, без дополнительной регистрации,
@@ -0,0 +1,290 @@
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// ВСЯКИЕ ГЛОБАЛЬНЫЕ НАСТРОЙКИ ЯДРА - В ФАЙЛЕ src/config.h !!!
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// НАГРУЗОЧНЫЙ ПРОГОН ПРИЁМНИКА RS-485: гоняет через RS485::update() случайный мусор вперемешку с валидными фреймами,
+// подаваемые с темпом реального UART, и считает, сколько фреймов восстановлено, сколько потеряно (отдельно - сразу после мусора),
+// сколько байт фреймов теряется на одну пересинхронизацию и сколько в худшем случае стоит обработка одного байта.
+// Железо не нужно - линия имитируется (src/transport/virtualline.h). Результаты выводятся в Serial.
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// настройки прошивки
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+#define SERIAL_SPEED 57600 // скорость работы Serial
+#define LINE_BAUD 57600 // скорость имитируемой линии RS-485
+#define FUZZ_ROUNDS 50 // кол-во прогонов
+#define FUZZ_BUFFER_SIZE 1024 // сколько байт эфира генерируется на один прогон
+#define FUZZ_MAX_FRAMES 64 // максимум фреймов на один прогон
+#define FUZZ_MAX_NOISE 24 // максимальная длина мусора перед фреймом
+#define FUZZ_MAX_PAYLOAD 32 // максимальная длина данных фрейма
+#define FUZZ_SEED 12345 // начальное значение генератора случайных чисел - прогоны воспроизводимы
+
+// раскомментировать для прогона транспорта с кольцевым буфером приёма (src/transport/rxring.h): байты из линии забираются
+// в буфер так, как это делало бы прерывание, а основной цикл время от времени "залипает" - ни один байт не должен потеряться
+//#define FUZZ_RX_RING_SIZE 512 // размер кольцевого буфера, степень двойки
+#define FUZZ_STALL_CHANCE 50 // в среднем раз во сколько итераций цикл залипает
+#define FUZZ_STALL_DURATION 30 // на сколько миллисекунд залипает цикл
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "src/core.h" // подключаем ядро
+#include "src/transport/rs485.h" // то, что гоняем
+#include "src/transport/virtualline.h" // имитация линии связи
+#include "src/transport/rxring.h" // кольцевой буфер приёма
+#include "src/utils/memorystream.h" // эфир прогона лежит в памяти
+#include "src/utils/crc8.h" // для сборки валидных фреймов
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// эфир
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint8_t lineBuffer[FUZZ_BUFFER_SIZE];
+MemoryStream lineData(lineBuffer,sizeof(lineBuffer));
+VirtualLine line(lineData,LINE_BAUD);
+
+#ifdef FUZZ_RX_RING_SIZE
+uint8_t rxBuffer[FUZZ_RX_RING_SIZE];
+RxRing rxRing(rxBuffer,sizeof(rxBuffer));
+RS485 rs485(rxRing, line, 4, 20); // приём - из кольцевого буфера, пин переключения приёма-передачи - 4, 20 миллисекунд на таймаут чтения входящих данных
+#else
+RS485 rs485(line, 4, 20); // пин переключения приёма-передачи - 4, 20 миллисекунд на таймаут чтения входящих данных
+#endif
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// учёт отосланных фреймов текущего прогона
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+  uint8_t length; // длина фрейма целиком, байт
+  bool afterNoise; // перед фреймом был мусор
+  bool received; // фрейм принят транспортом
+
+} FuzzFrame;
+
+FuzzFrame frames[FUZZ_MAX_FRAMES];
+uint8_t framesCount = 0;
+uint16_t roundFirstSeq = 0, nextSeq = 0;
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// итоги
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t framesSent = 0, framesRecovered = 0, missedAfterNoise = 0, missedClean = 0, unexpectedFrames = 0;
+uint32_t noiseBytes = 0, lostFrameBytes = 0;
+uint32_t busyTime = 0; // сколько микросекунд провели внутри update(), в которых были приняты байты
+uint32_t worstUpdate = 0; // самый долгий вызов update(), микросекунд
+uint32_t worstByteCost = 0; // худшая стоимость байта, наносекунд
+uint32_t stalls = 0; // сколько раз залипал цикл
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint8_t noiseByte()
+{
+  // мусор, щедро разбавленный байтами заголовка и окончания фрейма - самый неудобный для поиска начала фрейма
+  switch(random(8))
+  {
+    case 0: return STX1;
+    case 1: return STX2;
+    case 2: return ETX1;
+    default: return random(256);
+  }
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool addFrame(bool afterNoise)
+{
+  uint8_t payload[FUZZ_MAX_PAYLOAD];
+  uint8_t payloadLength = random(2,FUZZ_MAX_PAYLOAD+1);
+
+  if(framesCount >= FUZZ_MAX_FRAMES || lineData.length() + sizeof(RS485Packet) + payloadLength > FUZZ_BUFFER_SIZE)
+    return false;
+
+  // первые два байта данных - порядковый номер фрейма
+  memcpy(payload,&nextSeq,sizeof(nextSeq));
+  for(uint8_t i=sizeof(nextSeq);i<payloadLength;i++)
+    payload[i] = random(256);
+
+  RS485Packet packet;
+  packet.dataLength = payloadLength;
+  packet.dataCrc = crc8(payload,payloadLength);
+  packet.packetCrc = crc8((uint8_t*)&packet,sizeof(RS485Packet) - 1);
+
+  lineData.write((uint8_t*)&packet,sizeof(RS485Packet));
+  lineData.write(payload,payloadLength);
+
+  FuzzFrame* f = &(frames[framesCount++]);
+  f->length = sizeof(RS485Packet) + payloadLength;
+  f->afterNoise = afterNoise;
+  f->received = false;
+
+  nextSeq++;
+  framesSent++;
+
+  return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void fillRound()
+{
+  lineData.clear();
+  framesCount = 0;
+  roundFirstSeq = nextSeq;
+
+  while(true)
+  {
+    // половина фреймов идёт впритык друг к другу, половина - после мусора
+    uint8_t noiseLength = random(2) ? random(1,FUZZ_MAX_NOISE+1) : 0;
+
+    if(lineData.length() + noiseLength + sizeof(RS485Packet) + FUZZ_MAX_PAYLOAD > FUZZ_BUFFER_SIZE)
+      break;
+
+    for(uint8_t i=0;i<noiseLength;i++)
+      lineData.write(noiseByte());
+
+    // иногда мусор кончается первым байтом заголовка - получаем "AB AB BA ..."
+    if(noiseLength && !random(4))
+    {
+      lineData.write((uint8_t) STX1);
+      noiseLength++;
+    }
+
+    noiseBytes += noiseLength;
+
+    if(!addFrame(noiseLength > 0))
+      break;
+  }
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool checkReceived()
+{
+  if(!rs485.available())
+    return false;
+
+  uint16_t readed;
+  uint8_t* payload = rs485.read(readed);
+
+  uint16_t seq = 0;
+  if(readed >= sizeof(seq))
+    memcpy(&seq,payload,sizeof(seq));
+
+  uint16_t idx = seq - roundFirstSeq;
+  if(readed >= sizeof(seq) && idx < framesCount && !frames[idx].received)
+  {
+    frames[idx].received = true;
+    framesRecovered++;
+  }
+  else
+    unexpectedFrames++;
+
+  rs485.wipe();
+  return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint16_t pendingBytes()
+{
+  // байты, которые уже сняты с линии, но ещё не отданы транспорту
+  #ifdef FUZZ_RX_RING_SIZE
+    return rxRing.available();
+  #else
+    return 0;
+  #endif
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void runRound()
+{
+  fillRound();
+  line.restart();
+
+  while(lineData.available() || pendingBytes())
+  {
+    #ifdef FUZZ_RX_RING_SIZE
+      // так буфер наполняло бы прерывание
+      rxRing.fill(line);
+      
+      if(!random(FUZZ_STALL_CHANCE))
+      {
+        // цикл чем-то занят (например, пишет в EEPROM), а прерывание продолжает принимать байты
+        stalls++;
+        uint32_t stallStartedAt = uptime();
+        while(uptime() - stallStartedAt < FUZZ_STALL_DURATION)
+          rxRing.fill(line);
+      }
+    #endif
+
+    uint32_t bytesBefore = rs485.getStats().bytesRx;
+    uint32_t startedAt = micros();
+
+    rs485.update();
+
+    uint32_t elapsed = micros() - startedAt;
+    uint32_t consumed = rs485.getStats().bytesRx - bytesBefore;
+
+    if(consumed)
+    {
+      busyTime += elapsed;
+
+      if(elapsed > worstUpdate)
+        worstUpdate = elapsed;
+
+      uint32_t byteCost = (elapsed*1000ul)/consumed;
+      if(byteCost > worstByteCost)
+        worstByteCost = byteCost;
+    }
+
+    checkReceived();
+  }
+
+  // транспорт может держать у себя ещё не разобранные байты - забираем оставшиеся фреймы
+  do
+  {
+    rs485.update();
+  } while(checkReceived());
+
+  for(uint8_t i=0;i<framesCount;i++)
+  {
+    if(frames[i].received)
+      continue;
+
+    lostFrameBytes += frames[i].length;
+
+    if(frames[i].afterNoise)
+      missedAfterNoise++;
+    else
+      missedClean++;
+  }
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void setup()
+{
+  Serial.begin(SERIAL_SPEED);
+
+  randomSeed(FUZZ_SEED);
+  rs485.begin();
+
+  uint32_t startedAt = micros();
+
+  for(uint16_t i=0;i<FUZZ_ROUNDS;i++)
+    runRound();
+
+  uint32_t elapsed = micros() - startedAt;
+
+  TransportStats& stats = rs485.getStats();
+
+  Serial << F("RS485 fuzz, rounds: ") << FUZZ_ROUNDS << F(", line bytes: ") << stats.bytesRx << F(", noise bytes: ") << noiseBytes << ENDLINE;
+  Serial << F("frames sent: ") << framesSent << F(", recovered: ") << framesRecovered << F(", unexpected: ") << unexpectedFrames << ENDLINE;
+  Serial << F("missed after noise: ") << missedAfterNoise << F(", missed clean: ") << missedClean << ENDLINE;
+  #ifdef FUZZ_RX_RING_SIZE
+    Serial << F("rx ring: ") << FUZZ_RX_RING_SIZE << F(" bytes, loop stalls: ") << stalls << F(" x ") << FUZZ_STALL_DURATION << F(" ms, bytes lost: ") << stats.rxOverflows << ENDLINE;
+  #endif
+  
+  Serial << F("resyncs: ") << stats.resyncs << F(", packet CRC errors: ") << stats.packetCrcErrors << F(", data CRC errors: ") << stats.dataCrcErrors << F(", timeouts: ") << stats.timeouts << ENDLINE;
+
+  if(stats.resyncs)
+    Serial << F("frame bytes lost per resync: ") << (lostFrameBytes/stats.resyncs) << F(".") << ((lostFrameBytes%stats.resyncs)*10/stats.resyncs) << ENDLINE;
+
+  if(elapsed)
+    Serial << F("frames/s: ") << uint32_t((uint64_t(framesRecovered)*1000000ull)/elapsed) << F(" (line limit at ") << LINE_BAUD << F(" baud)") << ENDLINE;
+
+  if(stats.bytesRx)
+    Serial << F("avg byte cost: ") << uint32_t((uint64_t(busyTime)*1000ull)/stats.bytesRx) << F(" ns, worst byte cost: ") << worstByteCost << F(" ns, worst update(): ") << worstUpdate << F(" us") << ENDLINE;
+
+  Serial << (missedAfterNoise || missedClean || stats.rxOverflows ? F("FAIL: valid frames were lost") : F("PASS: every valid frame recovered")) << ENDLINE;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void loop()
+{
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -195,6 +195,8 @@ void setup()
   
   // добавляем транспорты для контроллера  
   controller.addTransport(rs485); // поддерживаем RS-485
+  // если транспортов несколько (например, два сегмента RS-485) - контроллер может пересылать данные слотов между ними:
+  // controller.setBridgeMode(true);
 
   // говорим контроллеру, чтобы он слушал команды из Serial
   controller.addStreamListener(controllerCommands);
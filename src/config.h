@@ -5,11 +5,20 @@
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 #define _DEBUG				// закомментировать для выключения отладочного режима
 #define DEBUG_SERIAL Serial // какой Serial использовать для вывода отладочной информации
+//#define USE_PROFILER		// раскомментировать для замера времени выполнения секций цикла обновления (GET=PROFILE)
+//#define COUNT_ALLOCATIONS	// раскомментировать для подсчёта выделений памяти слоем сообщений (нужно бенчмарку examples/MessageBenchmark)
+#define PROFILER_HISTOGRAM_BUCKETS 16 // кол-во корзин гистограммы профилировщика (по степеням двойки микросекунд)
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // настройки для хранения информации в хранилище
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 #define SETT_HEADER1 0x24 // байты, сигнализирующие о наличии сохранённых настроек, первый
 #define SETT_HEADER2 0x19 // и второй
+#define STORAGE_CACHE_LINES 4 // кол-во строк RAM-кэша хранилища (CachedStorage)
+#define STORAGE_CACHE_LINE_SIZE 16 // размер строки кэша, байт (не больше 16)
+#define RECORD_STORE_MAX_KEYS 16 // сколько разных ключей держит индекс журнального хранилища записей (RecordStore)
+#define CONFIG_STORAGE_ADDRESS 8 // с какого адреса хранилища модуль держит слоты конфигурации (до него - ID контроллера)
+#define CONFIG_FLUSH_DELAY 250 // через сколько миллисекунд после последнего сохранения слота конфигурации модуль сбрасывает хранилище (пачка сохранений - один сброс)
+#define CONFIG_FLUSH_MAX_DELAY 500 // но не позже, чем через столько миллисекунд после первого несброшенного сохранения (меньше CONFIG_SAVE_TIMEOUT)
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // настройки кнопки (button)
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -24,6 +33,68 @@
 #define STX2 0xBA	// второй байт начала фрейма
 #define ETX1 0xDE	// первый байт окончания фрейма
 #define ETX2 0xAD	// второй байт окончания фрейма
+#define RS485_RX_CHUNK 32 // сколько байт за раз забирается из кольцевого буфера приёма (RxRing)
+#define RS485_RX_RING_SIZE 128 // размер своего кольцевого буфера приёма RS485, работающего через поток (степень двойки)
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// настройки статистики транспортов
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define STATS_LATENCY_BUCKETS 12 // кол-во корзин гистограммы времени "запрос -> ответ" (по степеням двойки миллисекунд)
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// настройки расписания доступа к шине (TDMA)
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define TDMA_SLOT_DURATION 25 // длительность одного слота расписания, миллисекунд
+#define TDMA_GUARD_TIME 10 // защитный интервал в конце слота, миллисекунд: в него новые передачи уже не начинаются
+#define TDMA_BEACON_LOST_FRAMES 3 // через сколько кадров без маяка модуль считает расписание потерянным и возвращается к свободной передаче
+#define TDMA_MAX_QUEUED_MESSAGES 4 // сколько исходящих сообщений модуль держит в очереди до наступления своего слота
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// настройки отслеживания модулей на связи
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define LIVENESS_SILENCE_TIMEOUT 5000 // сколько миллисекунд модуль может молчать, прежде чем контроллер его пингует
+#define LIVENESS_MAX_MISSED_PINGS 3 // после скольких пингов без ответа модуль считается потерянным
+#define LIVENESS_MAX_PING_INTERVAL 60000ul // максимальный интервал между пингами потерянного модуля, миллисекунд
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// настройки слотов конфигурации
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define CONFIG_SAVE_TIMEOUT 1000 // сколько миллисекунд контроллер ждёт подтверждения сохранения слота конфигурации модулем
+#define CONFIG_MAX_PENDING_SAVES 8 // сколько неподтверждённых сохранений слотов конфигурации держит контроллер
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// настройки режима моста между транспортами
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define BRIDGE_QUEUE_SIZE 8 // сколько фреймов держит исходящая очередь каждого транспорта, при переполнении выбрасывается самый старый
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// настройки кэша данных слотов на контроллере
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define SLOT_CACHE_SIZE 32 // значения скольких слотов помнит контроллер, чтобы отдавать их в консоль без обращения к шине (не больше 254)
+#define SLOT_CACHE_INDEX_SIZE 64 // размер хэш-индекса кэша слотов: степень двойки, больше SLOT_CACHE_SIZE (чем просторнее - тем короче поиск)
+#define SLOT_DATA_MAX_LENGTH 8 // максимальная длина данных слота в кэше, байт (самые длинные данные, влажность, - 6 байт)
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// настройки опроса модулей контроллером
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define POLL_EVENTS_INTERVAL 1000 // как часто контроллер запрашивает события у модуля, у которого их не было, миллисекунд
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// настройки истории значений слотов на контроллере
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define HISTORY_MAX_SLOTS 2 // для скольких слотов контроллер может одновременно вести историю
+#define HISTORY_RAW_SAMPLES 16 // сколько последних значений слота хранится как есть
+#define HISTORY_BUCKETS 12 // сколько интервалов (min/max/среднее) хранится на каждом уровне огрубления
+#define HISTORY_LEVEL1_PERIOD 60000ul // длительность интервала первого уровня огрубления, миллисекунд
+#define HISTORY_LEVEL2_PERIOD 900000ul // длительность интервала второго уровня огрубления, миллисекунд
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// настройки правил на контроллере и модулях
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define RULES_MAX_COUNT 8 // сколько правил может держать контроллер или модуль (не больше 32 и не больше RECORD_STORE_MAX_KEYS)
+#define RULE_MAX_LENGTH 40 // максимальная длина кода правила, байт
+#define RULE_STACK_SIZE 8 // глубина стека вычисления правила
+#define RULES_STORAGE_ADDRESS 16 // с какого адреса хранилища контроллер держит журнал правил (до него - ID контроллера)
+#define RULES_STORAGE_SIZE 768 // сколько байт хранилища занимает журнал правил (обе половины, см. RecordStore)
+#define RULES_RESEND_INTERVAL 30000ul // как часто контроллер повторяет данные целевых слотов всех правил, миллисекунд
+#define MODULE_RULE_HEARD_SLOTS 8 // значения скольких чужих слотов, услышанных на шине, модуль помнит для своих правил
+#define MODULE_RULE_HEARD_TIMEOUT 35000ul // через сколько миллисекунд без новых данных услышанное значение чужого слота протухает
+#define MODULE_SLOT_REFRESH_INTERVAL 10000ul // как часто модуль повторяет на шине значение каждого исходящего слота, миллисекунд
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// настройки подписки консоли на данные слотов
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define SUBSCRIPTION_MAX_SUBSCRIBERS 4 // сколько потоков консоли могут быть подписаны одновременно
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // настройки текстовых команд для контроллера
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -32,6 +103,11 @@
 #define CORE_COMMAND_ANSWER_OK F("OK=") // какой префикс будет посылаться в ответ на команду получения данных и её успешной отработке
 #define CORE_COMMAND_ANSWER_ERROR F("ER=") // какой префикс будет посылаться в ответ на команду получения данных и её неуспешной отработке
 #define CORE_COMMAND_PARAM_DELIMITER '|' // разделитель параметров
+#define COMMAND_PARSER_MAX_ARGS 32 // максимальное кол-во аргументов команды (вместе с именем команды)
+#define STREAM_LISTENER_BUFFER_SIZE 201 // размер буфера строк команд по умолчанию (StreamListener), команды длиннее - выбрасываются
+#define STREAM_LISTENER_COMMANDS_PER_UPDATE 4 // сколько принятых команд одного слушателя контроллер выполняет за один вызов update, остальные ждут следующего
+#define BINARY_COMMAND_SYNC 0xC5 // первый байт кадра двоичного протокола команд, в начале строки означает, что дальше - не текст
+#define BINARY_COMMAND_TIMEOUT 100 // через сколько миллисекунд тишины недопринятый двоичный кадр выбрасывается
 
 
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
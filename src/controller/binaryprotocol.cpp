@@ -0,0 +1,39 @@
+#include "binaryprotocol.h"
+#include "../utils/crc8.h"
+//--------------------------------------------------------------------------------------------------------------------------------------
+BinaryFrameWriter::BinaryFrameWriter(Stream& s)
+{
+	workStream = &s;
+	crc = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void BinaryFrameWriter::begin(uint8_t batch, BinaryCommand command, BinaryStatus status, uint16_t dataLength)
+{
+	uint16_t payloadLength = 3 + dataLength;
+
+	workStream->write((uint8_t) BINARY_COMMAND_SYNC);
+
+	crc = 0;
+	write(payloadLength);
+	write(batch);
+	write(static_cast<uint8_t>(command));
+	write(static_cast<uint8_t>(status));
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void BinaryFrameWriter::write(const void* data, uint16_t length)
+{
+	const uint8_t* ptr = (const uint8_t*) data;
+
+	for(uint16_t i=0;i<length;i++)
+	{
+		crc = crc8_update(crc,ptr[i]);
+	}
+
+	workStream->write(ptr,length);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void BinaryFrameWriter::end()
+{
+	workStream->write(crc);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
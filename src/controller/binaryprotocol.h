@@ -0,0 +1,92 @@
+#pragma once
+
+#include <Arduino.h>
+#include "../config.h"
+//--------------------------------------------------------------------------------------------------------------------------------------
+/*
+	Двоичный протокол команд контроллера - работает в том же потоке, что и текстовые команды GET=/SET=,
+	и распознаётся по первому байту: текстовая команда не может начинаться с BINARY_COMMAND_SYNC.
+
+	Кадр (одинаков для запросов и ответов):
+
+		BINARY_COMMAND_SYNC, 1 байт
+		длина нагрузки, 2 байта
+		нагрузка
+		CRC8 длины и нагрузки, 1 байт
+
+	Нагрузка кадра запроса - пачка запросов, выполняемых по порядку:
+
+		номер пачки, 1 байт - возвращается в каждом кадре ответа
+		запросы, каждый:
+			- код команды (BinaryCommand), 1 байт
+			- длина аргументов, 1 байт
+			- аргументы
+
+	На каждый запрос пачки контроллер отвечает отдельным кадром, нагрузка которого:
+
+		номер пачки, 1 байт
+		код команды, 1 байт
+		результат (BinaryStatus), 1 байт
+		данные ответа - только при результате BinaryStatus::OK
+
+	После ответов на все запросы пачки приходит кадр с кодом команды BinaryCommand::End,
+	в данных которого - кол-во обработанных запросов (1 байт).
+
+	Все многобайтовые числа - в порядке байт контроллера (little-endian).
+*/
+//--------------------------------------------------------------------------------------------------------------------------------------
+enum class BinaryCommand : uint8_t
+{
+	End, // конец ответа на пачку запросов
+	ID, // аргументов нет, ответ: ID контроллера (4 байта), длина имени (1 байт), имя
+	Uptime, // аргументов нет, ответ: время работы, секунд (4 байта)
+	Stats, // аргументы: [индекс транспорта (1 байт)], ответ на каждый транспорт: индекс (1 байт), 10 счётчиков в порядке GET=STATS (по 4 байта), корзины задержек (по 2 байта)
+	Config, // аргументы: ID модуля (1 байт), [номер слота (1 байт)], ответ на каждый слот из кэша: ID модуля (1 байт), номер слота (1 байт), тип (2 байта), длина данных (2 байта), данные
+	Subscribe, // аргументы: мин. интервал между отправками слота, мс (2 байта), [ID слотов, по 2 байта], ответ: кол-во слотов в фильтре (1 байт)
+	Unsubscribe, // аргументов нет, ответ - только результат
+	SlotData, // не запрос: данные слота по подписке, с номером пачки запроса Subscribe, формат - см. subscription.cpp
+	Slots, // аргументы: [ID слотов, по 2 байта], ответ - одним кадром: кол-во слотов (1 байт), на каждый известный слот из кэша:
+		// ID слота (2 байта), ID модуля (1 байт), тип данных (2 байта), флаги (1 байт), возраст значения, мс (4 байта), длина данных (1 байт), данные
+	Modules, // аргументов нет, ответ - одним кадром: кол-во модулей (1 байт), на каждый модуль: ID (1 байт), на связи (1 байт),
+		// сколько миллисекунд назад слышали (4 байта), исходящих слотов (1 байт), входящих слотов (1 байт), длина имени (1 байт), имя
+	History, // аргументы: ID слота (2 байта), уровень (1 байт, 0 - сырые значения), ответ - одним кадром: ID слота (2 байта), уровень (1 байт),
+		// длительность интервала, мс (4 байта), кол-во записей (1 байт), записи от старых к новым: возраст, мс (4 байта), и
+		// на уровне 0 - значение (4 байта), на остальных - min, max, среднее (по 4 байта), кол-во значений (2 байта)
+};
+//--------------------------------------------------------------------------------------------------------------------------------------
+enum class BinaryStatus : uint8_t
+{
+	OK,
+	UnknownCommand, // неизвестный код команды
+	BadArguments, // не те аргументы или нет таких данных
+};
+//--------------------------------------------------------------------------------------------------------------------------------------
+// запись кадров двоичного протокола в поток: длина кадра должна быть известна заранее, зато ничего не буферизуется
+//--------------------------------------------------------------------------------------------------------------------------------------
+class BinaryFrameWriter
+{
+	public:
+		BinaryFrameWriter(Stream& s);
+
+		Stream* getStream() { return workStream; }
+
+		// начинает кадр ответа с нагрузкой длиной 3 + dataLength байт (номер пачки, команда, результат, данные)
+		void begin(uint8_t batch, BinaryCommand command, BinaryStatus status, uint16_t dataLength);
+
+		void write(const void* data, uint16_t length);
+
+		template<typename T>
+		void write(const T& val)
+		{
+			write(&val,sizeof(T));
+		}
+
+		// дописывает CRC кадра
+		void end();
+
+	private:
+
+		Stream* workStream;
+		uint8_t crc;
+};
+//--------------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,128 @@
+#include "bridge.h"
+//--------------------------------------------------------------------------------------------------------------------------------------
+// BridgeQueue
+//--------------------------------------------------------------------------------------------------------------------------------------
+BridgeQueue::BridgeQueue()
+{
+	head = 0;
+	count = 0;
+	
+	for(uint8_t i=0;i<BRIDGE_QUEUE_SIZE;i++)
+	{
+		frames[i].payload = NULL;
+		frames[i].payloadLength = 0;
+	}
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+BridgeQueue::~BridgeQueue()
+{
+	clear();
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void BridgeQueue::clear()
+{
+	for(uint8_t i=0;i<BRIDGE_QUEUE_SIZE;i++)
+	{
+		delete [] frames[i].payload;
+		frames[i].payload = NULL;
+		frames[i].payloadLength = 0;
+	}
+	
+	head = 0;
+	count = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool BridgeQueue::push(const uint8_t* payload, uint16_t payloadLength)
+{
+	bool result = true;
+	
+	if(count == BRIDGE_QUEUE_SIZE)
+	{
+		// очередь полна - выбрасываем самый старый фрейм, свежие данные слота важнее
+		delete [] frames[head].payload;
+		frames[head].payload = NULL;
+		head = (head + 1) % BRIDGE_QUEUE_SIZE;
+		count--;
+		result = false;
+	}
+	
+	BridgeFrame* f = &(frames[(head + count) % BRIDGE_QUEUE_SIZE]);
+	f->payloadLength = payloadLength;
+	f->payload = new uint8_t[payloadLength];
+	memcpy(f->payload,payload,payloadLength);
+	count++;
+	
+	return result;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool BridgeQueue::writeNext(Transport* t)
+{
+	if(!count)
+		return false;
+	
+	BridgeFrame* f = &(frames[head]);
+	t->write(f->payload,f->payloadLength);
+	
+	delete [] f->payload;
+	f->payload = NULL;
+	f->payloadLength = 0;
+	
+	head = (head + 1) % BRIDGE_QUEUE_SIZE;
+	count--;
+	
+	return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+// Bridge
+//--------------------------------------------------------------------------------------------------------------------------------------
+Bridge::Bridge()
+{
+	
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+Bridge::~Bridge()
+{
+	for(size_t i=0;i<queues.size();i++)
+	{
+		delete queues[i];
+	}
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void Bridge::addTransport(Transport* t)
+{
+	queues.push_back(new BridgeQueue());
+	transports.push_back(t);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void Bridge::relay(uint8_t fromIndex, uint32_t toMask, const uint8_t* payload, uint16_t payloadLength)
+{
+	for(size_t i=0;i<queues.size() && i < 32;i++)
+	{
+		if(i == fromIndex || !(toMask & (1ul << i)))
+			continue;
+		
+		if(!queues[i]->push(payload,payloadLength))
+		{
+			DBG(F("[BRIDGE] queue overflow at transport #"));
+			DBGLN(i);
+			transports[i]->getStats().queueOverflows++;
+		}
+	}
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool Bridge::update(uint8_t transportIndex)
+{
+	if(transportIndex >= queues.size())
+		return false;
+	
+	return queues[transportIndex]->writeNext(transports[transportIndex]);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void Bridge::clear()
+{
+	for(size_t i=0;i<queues.size();i++)
+	{
+		queues[i]->clear();
+	}
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
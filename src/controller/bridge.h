@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Arduino.h>
+#include "../utils/vector.h"
+#include "../config.h"
+#include "../transport/transport.h"
+#include <stddef.h>
+//--------------------------------------------------------------------------------------------------------------------------------------
+// фрейм, ожидающий отправки в транспорт
+typedef struct
+{
+	uint8_t* payload;
+	uint16_t payloadLength;
+	
+} BridgeFrame;
+//--------------------------------------------------------------------------------------------------------------------------------------
+// кольцевая исходящая очередь одного транспорта
+//--------------------------------------------------------------------------------------------------------------------------------------
+class BridgeQueue
+{
+	public:
+		BridgeQueue();
+		~BridgeQueue();
+		
+		// помещает копию фрейма в очередь, возвращает false, если ради этого пришлось выбросить самый старый фрейм
+		bool push(const uint8_t* payload, uint16_t payloadLength);
+		
+		// отсылает в транспорт самый старый фрейм из очереди
+		bool writeNext(Transport* t);
+		
+		uint8_t size() { return count; }
+		void clear();
+		
+	private:
+	
+		BridgeFrame frames[BRIDGE_QUEUE_SIZE];
+		uint8_t head, count;
+		
+		BridgeQueue(const BridgeQueue& rhs);
+		BridgeQueue& operator=(const BridgeQueue& rhs);
+};
+//--------------------------------------------------------------------------------------------------------------------------------------
+typedef Vector<BridgeQueue*> BridgeQueuesList;
+//--------------------------------------------------------------------------------------------------------------------------------------
+// пересылка данных слотов между модулями, висящими на разных транспортах.
+// у каждого транспорта своя исходящая очередь, поэтому медленный сегмент не тормозит быстрый.
+//--------------------------------------------------------------------------------------------------------------------------------------
+class Bridge
+{
+	public:
+		Bridge();
+		~Bridge();
+		
+		// добавляет очередь для очередного транспорта, индексы очередей совпадают с индексами транспортов контроллера
+		void addTransport(Transport* t);
+		
+		// ставит фрейм, принятый с транспорта fromIndex, в очереди всех остальных транспортов, для которых toMask выставлен бит
+		void relay(uint8_t fromIndex, uint32_t toMask, const uint8_t* payload, uint16_t payloadLength);
+		
+		// отсылает в транспорт один фрейм из его очереди, если есть что отсылать
+		bool update(uint8_t transportIndex);
+		
+		void clear();
+	
+	private:
+	
+		BridgeQueuesList queues;
+		Vector<Transport*> transports;
+};
+//--------------------------------------------------------------------------------------------------------------------------------------
@@ -1,11 +1,44 @@
 #include "controller.h"
 #include "../utils/uptime.h"
+#include "../utils/profiler.h"
 //--------------------------------------------------------------------------------------------------------------------------------------
 // список поддерживаемых команд
 //--------------------------------------------------------------------------------------------------------------------------------------
+const char CONFIG_COMMAND[] PROGMEM = "CONFIG"; // получить или сохранить слоты конфигурации модуля (GET=CONFIG|moduleID[|slot], SET=CONFIG|moduleID|slot|value[|slot|value...])
+const char HISTORY_COMMAND[] PROGMEM = "HISTORY"; // история значений слота (GET=HISTORY, GET=HISTORY|slotID[|level]), включить или выключить её ведение (SET=HISTORY|slotID|enabled)
 const char ID_COMMAND[] PROGMEM = "ID"; // получить ID контроллера (GET=ID)
+const char MODULES_COMMAND[] PROGMEM = "MODULES"; // получить список модулей одной строкой (GET=MODULES)
+const char PROFILE_COMMAND[] PROGMEM = "PROFILE"; // получить время выполнения секций цикла обновления (GET=PROFILE), только с USE_PROFILER
+const char RULE_COMMAND[] PROGMEM = "RULE"; // получить список правил или правило (GET=RULE, GET=RULE|number), поставить или удалить правило (SET=RULE|number|hexCode, SET=RULE|number)
+const char SLOTS_COMMAND[] PROGMEM = "SLOTS"; // получить значения слотов из кэша одной строкой (GET=SLOTS, GET=SLOTS|slotID|slotID...)
+const char STATS_COMMAND[] PROGMEM = "STATS"; // получить статистику транспортов (GET=STATS, GET=STATS|transportIndex)
+const char SUBSCRIBE_COMMAND[] PROGMEM = "SUBSCRIBE"; // подписаться на данные слотов (SET=SUBSCRIBE|minInterval|binary[|slotID...]), получить состояние подписки (GET=SUBSCRIBE)
+const char UNSUBSCRIBE_COMMAND[] PROGMEM = "UNSUBSCRIBE"; // отписаться от данных слотов (SET=UNSUBSCRIBE)
 const char UPTIME_COMMAND[] PROGMEM = "UPTIME"; // получить время работы контроллера, секунд (GET=UPTIME)
 //--------------------------------------------------------------------------------------------------------------------------------------
+// таблица команд: ОБЯЗАТЕЛЬНО отсортирована по имени команды (как strcmp), поиск в ней - половинным делением.
+// Кол-во аргументов - без учёта имени команды.
+//--------------------------------------------------------------------------------------------------------------------------------------
+const CommandDescriptor SmartController::commands[] PROGMEM =
+{
+	// имя команды, обработчик GET=, мин. аргументов GET=, обработчик SET=, мин. аргументов SET=
+	{ CONFIG_COMMAND,	&SmartController::getConfigCommand,		1,	&SmartController::setConfigCommand,	3 },
+	{ HISTORY_COMMAND,	&SmartController::getHistoryCommand,	0,	&SmartController::setHistoryCommand,	2 },
+	{ ID_COMMAND,		&SmartController::getIDCommand,			0,	NULL,								0 },
+	{ MODULES_COMMAND,	&SmartController::getModulesCommand,	0,	NULL,								0 },
+#ifdef USE_PROFILER
+	{ PROFILE_COMMAND,	&SmartController::getProfileCommand,	0,	NULL,								0 },
+#endif // USE_PROFILER
+	{ RULE_COMMAND,		&SmartController::getRuleCommand,		0,	&SmartController::setRuleCommand,	1 },
+	{ SLOTS_COMMAND,	&SmartController::getSlotsCommand,		0,	NULL,								0 },
+	{ STATS_COMMAND,	&SmartController::getStatsCommand,		0,	NULL,								0 },
+	{ SUBSCRIBE_COMMAND,	&SmartController::getSubscribeCommand,	0,	&SmartController::setSubscribeCommand,	2 },
+	{ UNSUBSCRIBE_COMMAND,	NULL,								0,	&SmartController::setUnsubscribeCommand,	0 },
+	{ UPTIME_COMMAND,	&SmartController::getUptimeCommand,		0,	NULL,								0 },
+};
+//--------------------------------------------------------------------------------------------------------------------------------------
+const uint8_t SmartController::COMMANDS_COUNT = sizeof(SmartController::commands)/sizeof(SmartController::commands[0]);
+//--------------------------------------------------------------------------------------------------------------------------------------
 // Module
 //--------------------------------------------------------------------------------------------------------------------------------------
 Module::Module(uint8_t mid, Transport* t)
@@ -15,11 +48,89 @@ Module::Module(uint8_t mid, Transport* t)
 	moduleName = NULL;
 	observeSlotsCount = 0;
 	broadcastSlotsCount = 0;
+	
+	// модуль создаётся по факту ответа на сканирование, т.е. он на связи
+	lastHeardAt = uptime();
+	lastPingAt = 0;
+	pingInterval = LIVENESS_SILENCE_TIMEOUT;
+	missedPings = 0;
+	pingPending = false;
+	online = true;
+	
+	nextSlotToRegister = 0;
+	lastEventRequestAt = 0;
+	moreEvents = true; // события модуля запрашиваем сразу после регистрации слотов
+	requestSlotID = 0;
+	dataRequestPending = false;
+	pollFrame = 0xFFFFFFFF;
+	
+	configSlots = NULL;
+	configSlotsCount = 0;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 Module::~Module()
 {
 	delete [] moduleName;
+	clearConfig();
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void Module::clearConfig()
+{
+	for(uint8_t i=0;i<configSlotsCount;i++)
+	{
+		delete [] configSlots[i].name;
+		delete [] configSlots[i].data;
+	}
+	
+	delete [] configSlots;
+	configSlots = NULL;
+	configSlotsCount = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void Module::setConfigSlotsCount(uint8_t cnt)
+{
+	clearConfig();
+	
+	if(!cnt)
+		return;
+	
+	configSlotsCount = cnt;
+	configSlots = new ModuleConfigSlot[cnt];
+	memset(configSlots,0,sizeof(ModuleConfigSlot)*cnt);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void Module::setConfigSlot(uint8_t idx, ConfigSlotType type, const char* nm, uint8_t nameLen, const uint8_t* data, uint16_t dataLength)
+{
+	ModuleConfigSlot* slot = getConfigSlot(idx);
+	if(!slot)
+		return;
+	
+	delete [] slot->name;
+	slot->name = new char[nameLen+1];
+	memcpy(slot->name,nm,nameLen);
+	slot->name[nameLen] = 0;
+	
+	slot->type = type;
+	slot->loaded = true;
+	
+	setConfigSlotData(idx,data,dataLength);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void Module::setConfigSlotData(uint8_t idx, const uint8_t* data, uint16_t dataLength)
+{
+	ModuleConfigSlot* slot = getConfigSlot(idx);
+	if(!slot)
+		return;
+	
+	delete [] slot->data;
+	slot->data = NULL;
+	slot->dataLength = dataLength;
+	
+	if(dataLength)
+	{
+		slot->data = new uint8_t[dataLength];
+		memcpy(slot->data,data,dataLength);
+	}
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void Module::setName(const char* nm, uint8_t len)
@@ -30,18 +141,122 @@ void Module::setName(const char* nm, uint8_t len)
 	moduleName[len] = 0;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
+bool Module::heard()
+{
+	lastHeardAt = uptime();
+	missedPings = 0;
+	pingPending = false;
+	pingInterval = LIVENESS_SILENCE_TIMEOUT;
+	
+	if(online)
+		return false;
+	
+	// пока модуль молчал, данные его слотов могли поменяться, а события - потеряться: перечитываем слоты заново
+	online = true;
+	nextSlotToRegister = 0;
+	return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool Module::needPing()
+{
+	uint32_t now = uptime();
+	
+	// модуль недавно что-то присылал - пинговать незачем, любой фрейм от модуля - доказательство жизни
+	if(now - lastHeardAt < LIVENESS_SILENCE_TIMEOUT)
+		return false;
+	
+	// уже пинговали, ждём ответа, либо выжидаем интервал до следующего пинга
+	if(pingPending && (now - lastPingAt) < pingInterval)
+		return false;
+	
+	return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool Module::pinged()
+{
+	bool wentOffline = false;
+	
+	if(pingPending)
+	{
+		// на предыдущий пинг ответа не было
+		if(missedPings < 0xFF)
+			missedPings++;
+		
+		if(online && missedPings >= LIVENESS_MAX_MISSED_PINGS)
+		{
+			online = false;
+			wentOffline = true;
+		}
+		
+		// удваиваем интервал, чтобы мёртвые модули не отъедали полосу шины
+		pingInterval *= 2;
+		if(pingInterval > LIVENESS_MAX_PING_INTERVAL)
+			pingInterval = LIVENESS_MAX_PING_INTERVAL;
+	}
+	
+	lastPingAt = uptime();
+	pingPending = true;
+	
+	return wentOffline;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool Module::needEventRequest()
+{
+	return moreEvents || (uptime() - lastEventRequestAt) >= POLL_EVENTS_INTERVAL;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void Module::eventRequested()
+{
+	lastEventRequestAt = uptime();
+	moreEvents = false;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void Module::eventReceived(const Message& m)
+{
+	// EventResponse: флаг наличия события (1 байт), тип события (2 байта), длина данных (2 байта), данные;
+	// данные события SlotDataChanged: ID модуля (1 байт), ID слота (2 байта)
+	if(!m.get<uint8_t>(0))
+		return; // событий у модуля нет
+	
+	// забираем события до последнего, не дожидаясь интервала опроса
+	moreEvents = true;
+	
+	if(m.getPayloadLength() < MESSAGE_HEADER_SIZE + 5 + 3 || static_cast<Events>(m.get<uint16_t>(1)) != Events::SlotDataChanged)
+		return;
+	
+	requestSlotID = m.get<uint16_t>(6);
+	dataRequestPending = true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
 // SmartController
 //--------------------------------------------------------------------------------------------------------------------------------------
 SmartController::SmartController(uint32_t _id, const char* _name, _Storage& _storage)
+	: rules(slotCache), ruleStore(_storage,RULES_STORAGE_ADDRESS,RULES_STORAGE_SIZE)
 {
 	controllerID = _id;
 	name = _name;
 	storage = &_storage;
 	maxModulesCount = 0xFF;
+	onlineListPending = 0;
+	bridgeMode = false;
+	memset(ruleOutputs,0,sizeof(ruleOutputs));
+	rulesResentAt = 0;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 SmartController::~SmartController()
 {
+	clearConfigSaves();
+	
+	for(size_t i=0;i<subscriptions.size();i++)
+	{
+		delete subscriptions[i];
+	}
+	
+	for(size_t i=0;i<histories.size();i++)
+	{
+		delete histories[i];
+	}
+	
 	for(size_t i=0;i<modulesList.size();i++)
 	{
 		delete modulesList[i];
@@ -63,6 +278,8 @@ void SmartController::begin(uint8_t maxModules)
 		DBGLN(savedID);
 		controllerID = savedID;
 	}
+	
+	loadRules();
 
 	
 	// стартуем все транспорты
@@ -148,31 +365,43 @@ void SmartController::updateScan()
 					// парсим входящий пакет
 					if(incoming.type == Messages::ScanResponse && incoming.controllerID == controllerID && incoming.moduleID == currentModuleIndex)
 					{
-						DBG(F("[C] ONLINE MODULE FOUND: #"));
-						DBGLN(currentModuleIndex);
+						transports[currentTransportIndex]->getStats().addLatency(uptime() - timer);
 						
-						//тут помещаем модуль в список онлайн модулей
-						Module* minf = new Module(currentModuleIndex,transports[currentTransportIndex]);
-						modulesList.push_back(minf);
+						if(bridgeMode && findModule(currentModuleIndex,NULL))
+						{
+							// мост пересылает фреймы с ID модуля-источника - модуль с тем же ID на другом транспорте
+							// от него не отличить, поэтому такой модуль не регистрируем
+							DBG(F("[C] Duplicate module ID on bridged transports, ignored: #"));
+							DBGLN(currentModuleIndex);
+						}
+						else
+						{
+							DBG(F("[C] ONLINE MODULE FOUND: #"));
+							DBGLN(currentModuleIndex);
 						
-						// получаем настройки модуля
-						uint8_t nameLen = incoming.get<uint8_t>(0);
-						uint8_t* nm =  incoming.get(1);
+							//тут помещаем модуль в список онлайн модулей
+							Module* minf = new Module(currentModuleIndex,transports[currentTransportIndex]);
+							modulesList.push_back(minf);
 						
-						minf->setName((const char*) nm,nameLen);
+							// получаем настройки модуля
+							uint8_t nameLen = incoming.get<uint8_t>(0);
+							uint8_t* nm =  incoming.get(1);
 						
-					//	DBG(F("module name: "));
-					//	DBGLN(minf->getName());
+							minf->setName((const char*) nm,nameLen);
 						
-						// теперь получаем кол-во публикуемых и подписываемых слотов
-						minf->setBroadcastSlotsCount(incoming.get<uint8_t>(1+nameLen));
-						minf->setObserveSlotsCount(incoming.get<uint8_t>(2+nameLen));
+						//	DBG(F("module name: "));
+						//	DBGLN(minf->getName());
 						
-					//	DBG(F("broadcast slots: "));
-					//	DBGLN(minf->getBroadcastSlots());
+							// теперь получаем кол-во публикуемых и подписываемых слотов
+							minf->setBroadcastSlotsCount(incoming.get<uint8_t>(1+nameLen));
+							minf->setObserveSlotsCount(incoming.get<uint8_t>(2+nameLen));
 						
-					//	DBG(F("observe slots: "));
-					//	DBGLN(minf->getObserveSlots());
+						//	DBG(F("broadcast slots: "));
+						//	DBGLN(minf->getBroadcastSlots());
+						
+						//	DBG(F("observe slots: "));
+						//	DBGLN(minf->getObserveSlots());
+						}
 					}
 					
 					// переходим на следующий модуль
@@ -225,12 +454,24 @@ void SmartController::scan()
 		return;
 	}
 	
+	// неотосланные сохранения конфигурации ссылаются на модули, которые сейчас будут удалены
+	clearConfigSaves();
+	
 	// чистим список модулей онлайн
 	for(size_t i=0;i<modulesList.size();i++)
 	{
 		delete modulesList[i];
 	}	
 	modulesList.empty();
+	
+	// на время сканирования маяки не шлём, модули опрашиваются строго по одному
+	for(size_t i=0;i<schedules.size();i++)
+	{
+		schedules[i].reset();
+	}
+	
+	// то, что не успели переслать между транспортами, уже неактуально
+	bridge.clear();
 
 	machineState = SmartControllerState::Scan; // переключаемся на ветку сканирования модулей
 	currentTransportIndex = 0;
@@ -246,6 +487,7 @@ void SmartController::askSlots()
 		// нечего опрашивать!!!
 		DBGLN(F("[C] No online modules, switch to normal work mode!"));
 		machineState = SmartControllerState::Normal;
+		publishOnlineModules();
 		scanning(false); // вызываем событие "сканирование завершено"
 		return;
 	}
@@ -254,41 +496,174 @@ void SmartController::askSlots()
 	
 	machineState = SmartControllerState::AskSlots; // переключаемся на ветку опроса слотов у всех онлайн-модулей
 	
-	//TODO: тут инициализация перед началом сканирования слотов!
+	// опрашиваем модули по одному, начиная с первого
+	currentModuleIndex = 0;
+	askSlotsState = AskSlotsState::AskConfiguration;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::askNextModuleSlots()
+{
+	currentModuleIndex++;
+	askSlotsState = AskSlotsState::AskConfiguration;
+	
+	if(currentModuleIndex < modulesList.size())
+		return;
+	
+	// все модули опрошены
+	DBGLN(F("[C] Slots asked, switch to normal work mode!"));
 	
-	//TODO: УДАЛИТЬ !!!
+	machineState = SmartControllerState::Normal;
 	scanning(false); // вызываем событие "сканирование завершено"
-
+	publishOnlineModules();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void SmartController::updateAskSlots()
 {
-	//TODO: тут обновление сканирования слотов!
+	Module* module = modulesList[currentModuleIndex];
+	Transport* t = module->getTransport();
+	
+	switch(askSlotsState)
+	{
+		case AskSlotsState::AskConfiguration:
+		{
+			DBG(F("[C] Ask configuration of module #"));
+			DBGLN(module->getID());
+			
+			Message m = Message::ConfigurationRequest(controllerID, module->getID());
+			
+			timeout = t->getReadingTimeout();
+			timer = uptime();
+			askSlotsState = AskSlotsState::WaitConfiguration;
+			
+			t->write(m.getPayload(),m.getPayloadLength());
+		}
+		break; // AskSlotsState::AskConfiguration
+		
+		case AskSlotsState::AskConfigSlot:
+		{
+			if(currentConfigSlot >= module->getConfigSlotsCount())
+			{
+				// все слоты конфигурации модуля в кэше
+				askNextModuleSlots();
+				break;
+			}
+			
+			Message m = Message::ConfigurationSlotRequest(controllerID, module->getID(), currentConfigSlot);
+			
+			timeout = t->getReadingTimeout();
+			timer = uptime();
+			askSlotsState = AskSlotsState::WaitConfigSlot;
+			
+			t->write(m.getPayload(),m.getPayloadLength());
+		}
+		break; // AskSlotsState::AskConfigSlot
+		
+		case AskSlotsState::WaitConfiguration:
+		case AskSlotsState::WaitConfigSlot:
+		{
+			if(uptime() - timer >= timeout)
+			{
+				// модуль не отвечает, его конфигурация останется неизвестной
+				DBG(F("[C] Module #"));
+				DBG(module->getID());
+				DBGLN(F(" not answering configuration request!"));
+				
+				askNextModuleSlots();
+				break;
+			}
+			
+			if(!t->available())
+				break;
+			
+			uint16_t payloadLength;
+			uint8_t* payload = t->read(payloadLength);
+			
+			Message incoming = Message::parse(payload,payloadLength);
+			
+			t->wipe();
+			
+			if(incoming.controllerID != controllerID || incoming.moduleID != module->getID())
+				break; // не ответ на наш запрос
+			
+			if(askSlotsState == AskSlotsState::WaitConfiguration && incoming.type == Messages::ConfigurationResponse)
+			{
+				t->getStats().addLatency(uptime() - timer);
+				
+				module->setConfigSlotsCount(incoming.get<uint8_t>(0));
+				
+				DBG(F("[C] Configuration slots: "));
+				DBGLN(module->getConfigSlotsCount());
+				
+				currentConfigSlot = 0;
+				askSlotsState = AskSlotsState::AskConfigSlot;
+			}
+			else
+				if(askSlotsState == AskSlotsState::WaitConfigSlot && incoming.type == Messages::ConfigurationSlotResponse && incoming.get<uint8_t>(0) == currentConfigSlot)
+				{
+					t->getStats().addLatency(uptime() - timer);
+					
+					cacheConfigSlot(module,incoming);
+					
+					currentConfigSlot++;
+					askSlotsState = AskSlotsState::AskConfigSlot;
+				}
+		}
+		break; // AskSlotsState::WaitConfiguration, AskSlotsState::WaitConfigSlot
+		
+	} // switch
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::cacheConfigSlot(Module* module, const Message& m)
+{
+	uint8_t slotNumber = m.get<uint8_t>(0);
+	ConfigSlotType type = static_cast<ConfigSlotType>(m.get<uint16_t>(1));
+	uint8_t nameLen = m.get<uint8_t>(3);
+	uint16_t dataLength = m.get<uint16_t>(4 + nameLen);
+	
+	if(m.getPayloadLength() < MESSAGE_HEADER_SIZE + 6 + nameLen + dataLength)
+		return; // битый ответ
+	
+	module->setConfigSlot(slotNumber, type, (const char*) m.get(4), nameLen, m.get(6 + nameLen), dataLength);
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 void SmartController::update()
 {
-	handleIncomingCommands();
-	updateTransports();
+	PROFILE_SECTION(ProfileSection::ControllerUpdate);
+	
+	{
+		PROFILE_SECTION(ProfileSection::ControllerCommands);
+		handleIncomingCommands();
+	}
+	
+	{
+		PROFILE_SECTION(ProfileSection::ControllerTransports);
+		updateTransports();
+	}
+	
+	// фоновая работа хранилища (например, отложенная запись)
+	storage->update();
 	
 	switch(machineState)
 	{
 		case SmartControllerState::Scan:
 		{
 			// сканируем эфир, обновляем эту ветку
+			PROFILE_SECTION(ProfileSection::ControllerScan);
 			updateScan();
 		}
 		break; // SmartControllerState::Scan
 		
 		case SmartControllerState::AskSlots:
 		{
+			PROFILE_SECTION(ProfileSection::ControllerAskSlots);
 			updateAskSlots();
 		}
 		break; // SmartControllerState::AskSlots
 		
 		case SmartControllerState::Normal:
 		{
-			//TODO: Нормальный режим работы !!!
+			PROFILE_SECTION(ProfileSection::ControllerNormal);
+			updateNormal();
 		}
 		break; // SmartControllerState::Normal
 		
@@ -296,112 +671,1645 @@ void SmartController::update()
 	
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void SmartController::updateTransports()
+void SmartController::updateNormal()
 {
-	// обновляем все транспорты
-	for(size_t i=0;i<transports.size();i++)
-	{
-		transports[i]->update();
-	}	
+	//TODO: Нормальный режим работы !!!
+	updateBeacons();
+	processIncoming();
+	updateLiveness();
+	updatePolling();
+	updateBridge();
+	updateConfigSaves();
+	updateSubscriptions();
+	updateRules();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void SmartController::startRegistration(uint32_t timeout)
+void SmartController::processIncoming()
 {
-	DBGLN(F("[C] Start registration!"));
-	//TODO: запуск процесса поиска модуля в режиме регистрации !!!
+	for(size_t i=0;i<transports.size();i++)
+	{
+		if(!transports[i]->available())
+			continue;
+		
+		uint16_t payloadLength;
+		uint8_t* payload = transports[i]->read(payloadLength);
+		
+		// тут парсим сообщение и понимаем, что к чему
+		Message incoming = Message::parse(payload,payloadLength);
+		
+		// говорим транспорту, что мы больше не нуждаемся в пакете
+		transports[i]->wipe();
+		
+		if(incoming.controllerID != controllerID)
+			continue; // чужая система
+		
+		processIncomingMessage(i,incoming);
+	}
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void SmartController::addTransport(Transport& t)
+void SmartController::processIncomingMessage(uint8_t transportIndex, const Message& m)
 {
-	transports.push_back(&t);
+	// любой фрейм от модуля считается доказательством того, что модуль на связи
+	Module* module = findModule(m.moduleID,transports[transportIndex]);
+	
+	if(module && module->isPingPending())
+		transports[transportIndex]->getStats().addLatency(uptime() - module->getLastPingAt());
+	
+	if(module && module->heard())
+	{
+		DBG(F("[C] Module back online: #"));
+		DBGLN(m.moduleID);
+		publishOnlineModules();
+		
+		// пока модуль молчал, данные правил до него могли не дойти - повторяем их в его транспорт
+		if(transportIndex < 32)
+			resendRuleOutputs(1ul << transportIndex);
+	}
+	
+	switch(m.type)
+	{
+		case Messages::Pong:
+		{
+			// всё нужное уже сделано выше
+		}
+		break;
+		
+		case Messages::BroadcastSlotData:
+		case Messages::AnyDataResponse:
+		{
+			// данные слота, модули с других транспортов их не слышат - пересылаем
+			if(bridgeMode)
+				relaySlotData(transportIndex,m);
+			
+			slotDataReceived(m);
+		}
+		break;
+		
+		case Messages::Event:
+		case Messages::EventResponse:
+		{
+			// событие SlotDataChanged - значение слота в кэше устарело, новое запросим у модуля
+			slotCache.markStale(m);
+			
+			if(module && m.type == Messages::EventResponse)
+				module->eventReceived(m);
+		}
+		break;
+		
+		case Messages::ConfigurationSlotResponse:
+		{
+			// слот конфигурации - обновляем кэш
+			if(module)
+				cacheConfigSlot(module,m);
+		}
+		break;
+		
+		case Messages::ConfigurationSlotSaved:
+		{
+			if(module)
+				configSlotSaved(module,m);
+		}
+		break;
+		
+		default:
+		break;
+		
+	} // switch
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void SmartController::addStreamListener(StreamListener& sl)
+void SmartController::slotDataReceived(const Message& m)
 {
-	listeners.push_back(&sl);
+	// новые данные слота: в кэш, в историю, правилам и подписчикам
+	bool evicted;
+	uint8_t cacheIndex = slotCache.update(m,evicted);
+	
+	if(cacheIndex != SLOT_CACHE_NO_INDEX)
+	{
+		recordHistory(cacheIndex);
+		rules.slotChanged(slotCache.getSlotID(cacheIndex));
+		publishSlotData(cacheIndex,evicted);
+	}
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void SmartController::handleIncomingCommands()
+void SmartController::relaySlotData(uint8_t transportIndex, const Message& m)
 {
-	for(size_t i=0;i<listeners.size();i++)
+	// пересылаем только в те транспорты, где есть хоть один модуль
+	uint32_t toMask = 0;
+	for(size_t i=0;i<modulesList.size();i++)
 	{
-		if(listeners[i]->hasCommand())
-		{
-			String command = listeners[i]->getCommand();
-			
-			if(command.startsWith(CORE_COMMAND_GET) || command.startsWith(CORE_COMMAND_SET))
-			{
-			  Stream* pStream = listeners[i]->getStream();
-			  processCommand(command,pStream);
-			}
-			
-			listeners[i]->clearCommand();
-		}
+		// модуль с тем же ID на другом транспорте (мост включили после сканирования) - получатели
+		// не отличат чужой фрейм от фрейма своего модуля, такие данные не пересылаем
+		if(modulesList[i]->getID() == m.moduleID && modulesList[i]->getTransport() != transports[transportIndex])
+			return;
 		
-	} // for
+		uint8_t idx = getTransportIndex(modulesList[i]->getTransport());
+		if(idx < 32)
+			toMask |= (1ul << idx);
+	}
+	
+	// фрейм пересылается как есть, с ID модуля-источника, поэтому модули на других транспортах
+	// обрабатывают его так же, как если бы подслушали его на своей шине
+	bridge.relay(transportIndex,toMask,m.getPayload(),m.getPayloadLength());
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void SmartController::processCommand(const String& command, Stream* answerTo)
+void SmartController::updateBridge()
 {
-	if(command.startsWith(CORE_COMMAND_SET)) // SET=...
+	// не более одного фрейма в каждый транспорт за проход, чтобы медленный сегмент не задерживал остальные
+	for(size_t i=0;i<transports.size();i++)
 	{
-			setCommand(command,answerTo);
+		if(canTransmit(i))
+			bridge.update(i);
 	}
-	else 
-		if(command.startsWith(CORE_COMMAND_GET)) // GET=...
-		{
-			getCommand(command,answerTo);
-		}
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void SmartController::setCommand(const String& command, Stream* answerTo)
+Subscription* SmartController::subscribe(Stream* s, uint16_t minInterval, bool binary, uint8_t batch)
 {
-	bool handled = false;
-	CommandParser cParser;
+	// повторная подписка того же потока заменяет старую
+	unsubscribe(s);
 	
-     if(cParser.parse(command,true))
-     {
-        const char* commandName = cParser.getArg(0);
-		
-		//TODO: ТУТ обработка команд на установку свойств !!!
-		
-	 }
-	 
-	 if(!handled)
-		 unknownCommand(answerTo);
+	if(subscriptions.size() >= SUBSCRIPTION_MAX_SUBSCRIBERS)
+		return NULL;
+	
+	Subscription* sub = new Subscription(s,slotCache,minInterval,binary,batch);
+	subscriptions.push_back(sub);
+	
+	return sub;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void SmartController::getCommand(const String& command, Stream* answerTo)
+Subscription* SmartController::findSubscription(Stream* s)
 {
-	bool handled = false;
-	CommandParser cParser;
+	for(size_t i=0;i<subscriptions.size();i++)
+	{
+		if(subscriptions[i]->getStream() == s)
+			return subscriptions[i];
+	}
 	
-	 if(cParser.parse(command,false))
-	 {
-		const char* commandName = cParser.getArg(0);
+	return NULL;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::unsubscribe(Stream* s)
+{
+	for(size_t i=0;i<subscriptions.size();i++)
+	{
+		if(subscriptions[i]->getStream() != s)
+			continue;
+		
+		delete subscriptions[i];
 		
-		if(!strcmp_P(commandName, ID_COMMAND)) // GET=ID, returns OK=ID|id|name
+		for(size_t j=i+1;j<subscriptions.size();j++)
 		{
-			okAnswer(answerTo, commandName) << controllerID << CORE_COMMAND_PARAM_DELIMITER << name << ENDLINE;
-			handled = true;
+			subscriptions[j-1] = subscriptions[j];
 		}
-		else
-			if(!strcmp_P(commandName, UPTIME_COMMAND)) // GET=UPTIME, returns OK=UPTIME|uptime
-			{
-				okAnswer(answerTo, commandName) << uint32_t(uptime()/1000ul) << ENDLINE;
-				handled = true;
-			}
-			
-		//TODO: ТУТ ОСТАЛЬНЫЕ КОМАНДЫ ЧТЕНИЯ СВОЙСТВ !!
-	 }
-	 
-	 if(!handled)
-		 unknownCommand(answerTo);	 
+		
+		subscriptions.pop();
+		
+		return true;
+	}
+	
+	return false;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void SmartController::unknownCommand(Stream* answerTo)
+void SmartController::publishSlotData(uint8_t cacheIndex, bool evicted)
 {
-	*answerTo << CORE_COMMAND_ANSWER_ERROR << F("UNKNOWN_COMMAND") << ENDLINE;
+	// в поток значения уйдут в updateSubscriptions() - прямо из кэша, здесь только помечаем запись
+	for(size_t i=0;i<subscriptions.size();i++)
+	{
+		if(evicted)
+			subscriptions[i]->forget(cacheIndex);
+		
+		subscriptions[i]->push(cacheIndex);
+	}
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::updateSubscriptions()
+{
+	for(size_t i=0;i<subscriptions.size();i++)
+	{
+		subscriptions[i]->update();
+	}
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+SlotHistory* SmartController::findHistory(uint16_t slotID)
+{
+	for(size_t i=0;i<histories.size();i++)
+	{
+		if(histories[i]->getSlotID() == slotID)
+			return histories[i];
+	}
+	
+	return NULL;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::recordHistory(uint8_t cacheIndex)
+{
+	SlotHistory* history = findHistory(slotCache.getSlotID(cacheIndex));
+	if(!history)
+		return;
+	
+	int32_t value;
+	if(AnyData::toNumber(static_cast<DataType>(slotCache.getDataType(cacheIndex)),slotCache.getData(cacheIndex),slotCache.getDataLength(cacheIndex),value))
+		history->add(value);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::setHistoryTracking(uint16_t slotID, bool enabled)
+{
+	SlotHistory* history = findHistory(slotID);
+	
+	if(enabled)
+	{
+		if(history)
+			return true;
+		
+		if(histories.size() >= HISTORY_MAX_SLOTS)
+			return false;
+		
+		histories.push_back(new SlotHistory(slotID));
+		return true;
+	}
+	
+	if(!history)
+		return false;
+	
+	for(size_t i=0;i<histories.size();i++)
+	{
+		if(histories[i] != history)
+			continue;
+		
+		for(size_t j=i+1;j<histories.size();j++)
+		{
+			histories[j-1] = histories[j];
+		}
+		
+		histories.pop();
+		break;
+	}
+	
+	delete history;
+	return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::loadRules()
+{
+	ruleStore.mount();
+	
+	uint8_t code[RULE_MAX_LENGTH];
+	
+	for(uint8_t i=0;i<RULES_MAX_COUNT;i++)
+	{
+		uint8_t len = ruleStore.read(i,code,sizeof(code));
+		
+		if(len && !rules.set(i,code,len))
+		{
+			DBG(F("[C] Bad rule #"));
+			DBGLN(i);
+		}
+	}
+	
+	DBG(F("[C] Rules loaded: "));
+	DBGLN(rules.getCount());
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::resendRuleOutputs(uint32_t transportsMask)
+{
+	for(uint8_t i=0;i<RULES_MAX_COUNT;i++)
+	{
+		if(rules.exists(i))
+			ruleOutputs[i] |= transportsMask;
+	}
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::updateRules()
+{
+	uint32_t changed = rules.update();
+	
+	// данные целевого слота рассылаются всем модулям, в каждый транспорт - в нашем окне расписания
+	uint32_t allTransports = transports.size() >= 32 ? 0xFFFFFFFF : ((1ul << transports.size()) - 1);
+	
+	// широковещательные данные никто не подтверждает - время от времени повторяем их, на случай потерь на шине
+	if(uptime() - rulesResentAt >= RULES_RESEND_INTERVAL)
+	{
+		rulesResentAt = uptime();
+		resendRuleOutputs(allTransports);
+	}
+	
+	for(uint8_t i=0;i<RULES_MAX_COUNT;i++)
+	{
+		if(changed & (1ul << i))
+			ruleOutputs[i] = allTransports; // если прежние данные ещё не ушли - уйдут сразу новые
+		
+		if(!ruleOutputs[i])
+			continue;
+		
+		uint16_t slotID;
+		uint8_t dataType;
+		uint8_t data[sizeof(int32_t)];
+		uint16_t dataLength = rules.getOutput(i,slotID,dataType,data);
+		
+		if(!dataLength)
+		{
+			ruleOutputs[i] = 0; // правило удалили или при этом результате писать нечего
+			continue;
+		}
+		
+		if(changed & (1ul << i))
+		{
+			// новое значение целевого слота сразу видно в кэше: консоли, подпискам и правилам, которые от него зависят
+			Message m = Message::AnyDataBroadcast(controllerID, 0xFF, slotID, dataType, data, dataLength);
+			slotDataReceived(m);
+		}
+		
+		for(size_t t=0;t<transports.size() && t < 32;t++)
+		{
+			uint32_t bit = (1ul << t);
+			
+			if(!(ruleOutputs[i] & bit) || !canTransmit(t))
+				continue;
+			
+			Message m = Message::AnyDataBroadcast(controllerID, 0xFF, slotID, dataType, data, dataLength);
+			transports[t]->write(m.getPayload(),m.getPayloadLength());
+			
+			ruleOutputs[i] &= ~bit;
+		}
+	}
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::queueConfigSave(Module* module, uint8_t slotNumber, const char* value)
+{
+	ModuleConfigSlot* slot = module->getConfigSlot(slotNumber);
+	
+	if(!slot || !slot->loaded || pendingConfigSaves.size() >= CONFIG_MAX_PENDING_SAVES)
+		return false;
+	
+	// переводим текстовое значение из консоли в данные слота, в зависимости от типа слота
+	PendingConfigSave ps;
+	ps.module = module;
+	ps.slotNumber = slotNumber;
+	ps.sentAt = 0;
+	ps.sent = false;
+	
+	switch(slot->type)
+	{
+		case ConfigSlotType::Number:
+		{
+			int32_t val = atol(value);
+			ps.dataLength = sizeof(val);
+			ps.data = new uint8_t[ps.dataLength];
+			memcpy(ps.data,&val,sizeof(val));
+		}
+		break;
+		
+		case ConfigSlotType::Flag:
+		{
+			ps.dataLength = 1;
+			ps.data = new uint8_t[ps.dataLength];
+			ps.data[0] = atoi(value) ? 1 : 0;
+		}
+		break;
+		
+		case ConfigSlotType::String:
+		{
+			ps.dataLength = strlen(value);
+			ps.data = new uint8_t[ps.dataLength ? ps.dataLength : 1];
+			memcpy(ps.data,value,ps.dataLength);
+		}
+		break;
+		
+		case ConfigSlotType::Raw:
+		default:
+		{
+			// шестнадцатеричная строка, по два символа на байт
+			size_t len = strlen(value);
+			if(len % 2)
+				return false;
+			
+			for(size_t i=0;i<len;i++)
+			{
+				if(!isxdigit(value[i]))
+					return false;
+			}
+			
+			ps.dataLength = len/2;
+			ps.data = new uint8_t[ps.dataLength ? ps.dataLength : 1];
+			
+			for(uint16_t i=0;i<ps.dataLength;i++)
+			{
+				char hex[3] = {value[i*2], value[i*2+1], 0};
+				ps.data[i] = strtoul(hex,NULL,16);
+			}
+		}
+		break;
+	}
+	
+	pendingConfigSaves.push_back(ps);
+	
+	return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::updateConfigSaves()
+{
+	uint32_t now = uptime();
+	uint32_t sentMask = 0; // транспорты, в которые уже отослали сохранение за этот проход
+	
+	for(size_t i=0;i<pendingConfigSaves.size();)
+	{
+		PendingConfigSave* ps = &(pendingConfigSaves[i]);
+		uint8_t transportIndex = getTransportIndex(ps->module->getTransport());
+		
+		if(ps->sent)
+		{
+			if(now - ps->sentAt >= CONFIG_SAVE_TIMEOUT)
+			{
+				DBG(F("[C] No answer on configuration save, module #"));
+				DBGLN(ps->module->getID());
+				
+				removeConfigSave(i);
+				continue;
+			}
+		}
+		else
+			if(transportIndex < 32 && !(sentMask & (1ul << transportIndex)) && canTransmit(transportIndex))
+			{
+				// не более одного сохранения в каждый транспорт за проход - модуль разбирает по одному фрейму за раз
+				Message m = Message::SaveConfigurationSlot(controllerID, ps->module->getID(), ps->slotNumber, ps->data, ps->dataLength);
+				ps->module->getTransport()->write(m.getPayload(),m.getPayloadLength());
+				
+				ps->sent = true;
+				ps->sentAt = now;
+				sentMask |= (1ul << transportIndex);
+			}
+		
+		i++;
+	}
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::configSlotSaved(Module* module, const Message& m)
+{
+	uint8_t slotNumber = m.get<uint8_t>(0);
+	bool success = m.get<uint8_t>(1);
+	
+	for(size_t i=0;i<pendingConfigSaves.size();i++)
+	{
+		PendingConfigSave* ps = &(pendingConfigSaves[i]);
+		
+		if(!ps->sent || ps->module != module || ps->slotNumber != slotNumber)
+			continue;
+		
+		if(success)
+		{
+			// модуль сохранил слот - кэш теперь совпадает с модулем
+			module->setConfigSlotData(slotNumber,ps->data,ps->dataLength);
+		}
+		else
+		{
+			DBG(F("[C] Configuration slot #"));
+			DBG(slotNumber);
+			DBG(F(" not saved by module #"));
+			DBGLN(module->getID());
+		}
+		
+		removeConfigSave(i);
+		break;
+	}
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::removeConfigSave(size_t idx)
+{
+	delete [] pendingConfigSaves[idx].data;
+	
+	for(size_t i=idx+1;i<pendingConfigSaves.size();i++)
+	{
+		pendingConfigSaves[i-1] = pendingConfigSaves[i];
+	}
+	
+	pendingConfigSaves.pop();
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::clearConfigSaves()
+{
+	for(size_t i=0;i<pendingConfigSaves.size();i++)
+	{
+		delete [] pendingConfigSaves[i].data;
+	}
+	
+	pendingConfigSaves.empty();
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+Module* SmartController::findModule(uint8_t moduleID, Transport* t)
+{
+	for(size_t i=0;i<modulesList.size();i++)
+	{
+		Module* m = modulesList[i];
+		if(m->getID() == moduleID && (!t || m->getTransport() == t))
+			return m;
+	}
+	
+	return NULL;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+uint8_t SmartController::getTransportIndex(Transport* t)
+{
+	for(size_t i=0;i<transports.size();i++)
+	{
+		if(transports[i] == t)
+			return i;
+	}
+	
+	return 0xFF;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::updateLiveness()
+{
+	for(size_t i=0;i<modulesList.size();i++)
+	{
+		Module* module = modulesList[i];
+		
+		if(!module->needPing())
+			continue;
+		
+		uint8_t transportIndex = getTransportIndex(module->getTransport());
+		if(transportIndex == 0xFF || !canTransmit(transportIndex))
+			continue; // не наше окно в расписании, пингуем позже
+		
+		if(module->pinged())
+		{
+			DBG(F("[C] Module went offline: #"));
+			DBGLN(module->getID());
+			publishOnlineModules();
+		}
+		
+		Message m = Message::Ping(controllerID, module->getID());
+		module->getTransport()->write(m.getPayload(),m.getPayloadLength());
+	}
+	
+	// рассылаем список онлайн-модулей по тем транспортам, куда ещё не отослали
+	if(!onlineListPending)
+		return;
+	
+	uint8_t mask[ONLINE_MODULES_MASK_SIZE];
+	memset(mask,0,sizeof(mask));
+	
+	for(size_t i=0;i<modulesList.size();i++)
+	{
+		if(modulesList[i]->isOnline())
+		{
+			uint8_t id = modulesList[i]->getID();
+			mask[id/8] |= (1 << (id%8));
+		}
+	}
+	
+	for(size_t i=0;i<transports.size() && i < 32;i++)
+	{
+		uint32_t bit = (1ul << i);
+		
+		if(!(onlineListPending & bit) || !canTransmit(i))
+			continue;
+		
+		Message m = Message::OnlineModulesList(controllerID, 0xFF, mask);
+		transports[i]->write(m.getPayload(),m.getPayloadLength());
+		
+		onlineListPending &= ~bit;
+	}
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::updatePolling()
+{
+	for(size_t i=0;i<modulesList.size();i++)
+	{
+		Module* module = modulesList[i];
+		
+		if(!module->isOnline())
+			continue; // потерянный модуль только пингуем
+		
+		uint8_t transportIndex = getTransportIndex(module->getTransport());
+		if(transportIndex == 0xFF || !canTransmit(transportIndex))
+			continue; // не наше окно в расписании
+		
+		uint32_t frameStart = schedules[transportIndex].getFrameStart();
+		if(module->getPollFrame() == frameStart)
+			continue; // в этом кадре модуль уже опрошен, ответ ещё не пришёл
+		
+		// сначала - данные слота по последнему событию, потом - регистрация слотов, потом - события
+		if(module->needDataRequest())
+		{
+			Message m = Message::AnyDataRequest(controllerID, module->getID(), module->dataRequested());
+			module->getTransport()->write(m.getPayload(),m.getPayloadLength());
+		}
+		else
+		if(module->needSlotRegistration())
+		{
+			Message m = Message::BroadcastSlotRegister(controllerID, module->getID(), module->slotRegistrationRequested());
+			module->getTransport()->write(m.getPayload(),m.getPayloadLength());
+		}
+		else
+		if(module->needEventRequest())
+		{
+			module->eventRequested();
+			Message m = Message::EventRequest(controllerID, module->getID());
+			module->getTransport()->write(m.getPayload(),m.getPayloadLength());
+		}
+		else
+			continue;
+		
+		module->setPollFrame(frameStart);
+	}
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::publishOnlineModules()
+{
+	// список будет отослан в каждый транспорт (не более 32-х) в нашем окне расписания
+	onlineListPending = 0xFFFFFFFF;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::updateBeacons()
+{
+	uint32_t now = uptime();
+	
+	for(size_t i=0;i<transports.size();i++)
+	{
+		TDMASchedule* s = &(schedules[i]);
+		
+		if(s->synced() && (now - s->getFrameStart()) < s->getFrameLength())
+			continue; // текущий кадр расписания ещё не закончился
+			
+		sendBeacon(i);
+	}
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::sendBeacon(uint8_t transportIndex)
+{
+	Transport* t = transports[transportIndex];
+	
+	// считаем модули, которые висят на этом транспорте
+	uint8_t cnt = 0;
+	for(size_t i=0;i<modulesList.size();i++)
+	{
+		if(modulesList[i]->getTransport() == t)
+			cnt++;
+	}
+	
+	if(!cnt)
+	{
+		// на шине никого нет - и делить её не с кем
+		schedules[transportIndex].reset();
+		return;
+	}
+	
+	// ID модулей пишем прямо в нагрузку маяка, после длительности слота и кол-ва модулей
+	Message m = Message::Beacon(controllerID, TDMA_SLOT_DURATION, NULL, cnt);
+	uint8_t* ids = m.get(3);
+	uint8_t writeIdx = 0;
+	
+	for(size_t i=0;i<modulesList.size() && writeIdx < cnt;i++)
+	{
+		if(modulesList[i]->getTransport() == t)
+			ids[writeIdx++] = modulesList[i]->getID();
+	}
+	
+	// кадр начинается с нашего маяка, нулевой слот кадра - наш
+	schedules[transportIndex].sync(uptime(), TDMA_SLOT_DURATION, cnt, 0);
+	
+	t->write(m.getPayload(),m.getPayloadLength());
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::updateTransports()
+{
+	// обновляем все транспорты
+	for(size_t i=0;i<transports.size();i++)
+	{
+		transports[i]->update();
+	}	
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::startRegistration(uint32_t timeout)
+{
+	DBGLN(F("[C] Start registration!"));
+	//TODO: запуск процесса поиска модуля в режиме регистрации !!!
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::addTransport(Transport& t)
+{
+	transports.push_back(&t);
+	schedules.push_back(TDMASchedule());
+	bridge.addTransport(&t);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::addStreamListener(StreamListener& sl)
+{
+	listeners.push_back(&sl);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::handleIncomingCommands()
+{
+	for(size_t i=0;i<listeners.size();i++)
+	{
+		// хост может прислать команды пачкой - выполняем не больше STREAM_LISTENER_COMMANDS_PER_UPDATE за проход,
+		// остальные ждут в буфере слушателя, чтобы пачка не задерживала опрос транспортов
+		for(uint8_t handled=0;handled < STREAM_LISTENER_COMMANDS_PER_UPDATE && listeners[i]->hasCommand();handled++)
+		{
+			if(listeners[i]->isBinaryCommand())
+			{
+				uint16_t length;
+				const uint8_t* payload = listeners[i]->getBinaryCommand(length);
+				processBinaryCommand(payload,length,listeners[i]->getStream());
+			}
+			else
+				processCommand(listeners[i]->getCommand(),listeners[i]->getStream());
+			
+			listeners[i]->clearCommand();
+		}
+		
+	} // for
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::commandStartsWith(const char* command, const __FlashStringHelper* prefix)
+{
+	const char* p = (const char*) prefix;
+	return !strncmp_P(command,p,strlen_P(p));
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::isNumber(const char* arg)
+{
+	// atoi() молча превращает мусор в 0, а 0 - допустимый номер транспорта или слота
+	if(!*arg)
+		return false;
+	
+	while(*arg)
+	{
+		if(!isdigit(*arg++))
+			return false;
+	}
+	
+	return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::processCommand(char* command, Stream* answerTo)
+{
+	bool isSetCommand = commandStartsWith(command,CORE_COMMAND_SET); // SET=...
+	
+	if(!isSetCommand && !commandStartsWith(command,CORE_COMMAND_GET)) // GET=...
+		return;
+	
+	bool handled = false;
+	CommandParser cParser;
+	
+	if(cParser.parse(command,isSetCommand))
+	{
+		CommandDescriptor cmd;
+		
+		if(findCommand(cParser.getArg(0),cmd))
+		{
+			CommandHandler handler = isSetCommand ? cmd.setHandler : cmd.getHandler;
+			uint8_t minArgs = isSetCommand ? cmd.setMinArgs : cmd.getMinArgs;
+			
+			if(handler && cParser.argsCount() > minArgs)
+				handled = (this->*handler)(cParser,answerTo);
+		}
+	}
+	
+	if(!handled)
+		unknownCommand(answerTo);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::findCommand(const char* commandName, CommandDescriptor& result)
+{
+	// таблица команд отсортирована по имени - ищем половинным делением
+	int16_t left = 0, right = COMMANDS_COUNT - 1;
+	
+	while(left <= right)
+	{
+		int16_t mid = (left + right)/2;
+		memcpy_P(&result,&(commands[mid]),sizeof(CommandDescriptor));
+		
+		int cmp = strcmp_P(commandName,result.name);
+		
+		if(!cmp)
+			return true;
+		
+		if(cmp < 0)
+			right = mid - 1;
+		else
+			left = mid + 1;
+	}
+	
+	return false;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::getIDCommand(const CommandParser& cParser, Stream* answerTo) // GET=ID, returns OK=ID|id|name
+{
+	okAnswer(answerTo, cParser.getArg(0)) << controllerID << CORE_COMMAND_PARAM_DELIMITER << name << ENDLINE;
+	return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::getUptimeCommand(const CommandParser& cParser, Stream* answerTo) // GET=UPTIME, returns OK=UPTIME|uptime
+{
+	okAnswer(answerTo, cParser.getArg(0)) << uint32_t(uptime()/1000ul) << ENDLINE;
+	return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::getStatsCommand(const CommandParser& cParser, Stream* answerTo) // GET=STATS[|transportIndex], returns OK=STATS|transportIndex|framesRx|framesTx|bytesRx|bytesTx|resyncs|packetCrcErrors|dataCrcErrors|timeouts|queueOverflows|rxOverflows|latency0|...|latencyN for every requested transport
+{
+	size_t from = 0, to = transports.size();
+	if(cParser.argsCount() > 1)
+	{
+		if(!isNumber(cParser.getArg(1)) || strlen(cParser.getArg(1)) > 3)
+			return false;
+		
+		from = atoi(cParser.getArg(1));
+		to = from + 1;
+	}
+	
+	if(!(from < to && to <= transports.size()))
+		return false;
+	
+	for(size_t i=from;i<to;i++)
+	{
+		printStats(answerTo, cParser.getArg(0), i);
+	}
+	
+	return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+#ifdef USE_PROFILER
+bool SmartController::getProfileCommand(const CommandParser& cParser, Stream* answerTo) // GET=PROFILE, returns OK=PROFILE|section|count|min|avg|max|h0|...|hN for every executed section, times in microseconds
+{
+	for(uint8_t i=0;i<PROFILE_SECTIONS_COUNT;i++)
+	{
+		ProfileSection section = static_cast<ProfileSection>(i);
+		if(!Profiler::get(section).count)
+			continue;
+		
+		okAnswer(answerTo, cParser.getArg(0));
+		Profiler::print(*answerTo, section);
+		*answerTo << ENDLINE;
+	}
+	
+	return true;
+}
+#endif // USE_PROFILER
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::getConfigCommand(const CommandParser& cParser, Stream* answerTo) // GET=CONFIG|moduleID[|slot], returns OK=CONFIG|moduleID|slot|name|type|value for every requested slot, from the controller cache
+{
+	Module* module = findModule(atoi(cParser.getArg(1)),NULL);
+	
+	if(!module)
+		return false;
+	
+	uint8_t from = 0, to = module->getConfigSlotsCount();
+	if(cParser.argsCount() > 2)
+	{
+		if(!isNumber(cParser.getArg(2)) || strlen(cParser.getArg(2)) > 3 || atoi(cParser.getArg(2)) >= to)
+			return false;
+		
+		from = atoi(cParser.getArg(2));
+		to = from + 1;
+	}
+	
+	bool handled = false;
+	
+	for(uint8_t i=from;i<to;i++)
+	{
+		ModuleConfigSlot* slot = module->getConfigSlot(i);
+		if(!slot || !slot->loaded)
+			continue;
+		
+		printConfigSlot(answerTo, cParser.getArg(0), module, i);
+		handled = true;
+	}
+	
+	return handled;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::setConfigCommand(const CommandParser& cParser, Stream* answerTo) // SET=CONFIG|moduleID|slot|value[|slot|value...], returns OK=CONFIG|moduleID|queuedCount
+{
+	Module* module = findModule(atoi(cParser.getArg(1)),NULL);
+	
+	if(!module)
+		return false;
+	
+	// сохранения уходят на модуль в нашем окне расписания, модуль сбросит их в хранилище одним махом
+	uint8_t queued = 0;
+	for(size_t i=2;i+1<cParser.argsCount();i+=2)
+	{
+		if(queueConfigSave(module,atoi(cParser.getArg(i)),cParser.getArg(i+1)))
+			queued++;
+	}
+	
+	if(!queued)
+		return false;
+	
+	okAnswer(answerTo, cParser.getArg(0)) << module->getID() << CORE_COMMAND_PARAM_DELIMITER << queued << ENDLINE;
+	return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::getSubscribeCommand(const CommandParser& cParser, Stream* answerTo) // GET=SUBSCRIBE, returns OK=SUBSCRIBE|minInterval|binary|filterSize|coalesced|dropped for the subscription of this stream
+{
+	Subscription* sub = findSubscription(answerTo);
+	
+	if(!sub)
+		return false;
+	
+	okAnswer(answerTo, cParser.getArg(0)) << sub->getInterval()
+		<< CORE_COMMAND_PARAM_DELIMITER << (sub->isBinary() ? 1 : 0)
+		<< CORE_COMMAND_PARAM_DELIMITER << sub->getFilterSize()
+		<< CORE_COMMAND_PARAM_DELIMITER << sub->getCoalesced()
+		<< CORE_COMMAND_PARAM_DELIMITER << sub->getDropped()
+		<< ENDLINE;
+	
+	return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::setSubscribeCommand(const CommandParser& cParser, Stream* answerTo) // SET=SUBSCRIBE|minInterval|binary[|slotID...], returns OK=SUBSCRIBE|filterSize, then pushes OK=SLOT|moduleID|slotID|dataType|flags|hexData (or binary SlotData frames) on every slot change
+{
+	Subscription* sub = subscribe(answerTo,atol(cParser.getArg(1)),atoi(cParser.getArg(2)),0);
+	
+	if(!sub)
+		return false;
+	
+	for(size_t i=3;i<cParser.argsCount();i++)
+	{
+		sub->addFilter(atol(cParser.getArg(i)));
+	}
+	
+	okAnswer(answerTo, cParser.getArg(0)) << sub->getFilterSize() << ENDLINE;
+	return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::setUnsubscribeCommand(const CommandParser& cParser, Stream* answerTo) // SET=UNSUBSCRIBE, returns OK=UNSUBSCRIBE|coalesced|dropped - final counters of the removed subscription
+{
+	Subscription* sub = findSubscription(answerTo);
+	
+	if(!sub)
+		return false;
+	
+	okAnswer(answerTo, cParser.getArg(0)) << sub->getCoalesced() << CORE_COMMAND_PARAM_DELIMITER << sub->getDropped() << ENDLINE;
+	unsubscribe(answerTo);
+	
+	return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::getSlotsCommand(const CommandParser& cParser, Stream* answerTo) // GET=SLOTS[|slotID...], returns OK=SLOTS|count|slotID|moduleID|dataType|flags|age|hexData|... in one line, for every requested slot found in the controller cache, age in milliseconds
+{
+	// без аргументов - все слоты из кэша, неизвестные слоты в ответ не попадают
+	size_t requested = cParser.argsCount() - 1;
+	size_t count = 0;
+	
+	if(requested)
+	{
+		for(size_t i=0;i<requested;i++)
+		{
+			if(slotCache.find(atol(cParser.getArg(i+1))) != SLOT_CACHE_NO_INDEX)
+				count++;
+		}
+	}
+	else
+		count = slotCache.size();
+	
+	okAnswer(answerTo, cParser.getArg(0)) << count;
+	
+	size_t total = requested ? requested : slotCache.size();
+	
+	for(size_t i=0;i<total;i++)
+	{
+		uint8_t idx = requested ? slotCache.find(atol(cParser.getArg(i+1))) : i;
+		
+		if(idx != SLOT_CACHE_NO_INDEX)
+			writeSlotValue(answerTo,idx);
+	}
+	
+	*answerTo << ENDLINE;
+	return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::getHistoryCommand(const CommandParser& cParser, Stream* answerTo) // GET=HISTORY returns OK=HISTORY|count|slotID|... - slots with history; GET=HISTORY|slotID[|level] returns OK=HISTORY|slotID|level|period|count|age|value|... for level 0 (raw values) or OK=HISTORY|slotID|level|period|count|age|min|max|avg|samples|... for rollup levels, oldest first, ages in milliseconds
+{
+	if(cParser.argsCount() < 2)
+	{
+		okAnswer(answerTo, cParser.getArg(0)) << histories.size();
+		
+		for(size_t i=0;i<histories.size();i++)
+		{
+			*answerTo << CORE_COMMAND_PARAM_DELIMITER << histories[i]->getSlotID();
+		}
+		
+		*answerTo << ENDLINE;
+		return true;
+	}
+	
+	SlotHistory* history = findHistory(atol(cParser.getArg(1)));
+	uint8_t level = cParser.argsCount() > 2 ? atoi(cParser.getArg(2)) : 0;
+	
+	if(!history || level > HISTORY_ROLLUP_LEVELS)
+		return false;
+	
+	okAnswer(answerTo, cParser.getArg(0));
+	writeHistory(answerTo,history,level);
+	*answerTo << ENDLINE;
+	
+	return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::setHistoryCommand(const CommandParser& cParser, Stream* answerTo) // SET=HISTORY|slotID|enabled, returns OK=HISTORY|slotID|enabled
+{
+	uint16_t slotID = atol(cParser.getArg(1));
+	bool enabled = atoi(cParser.getArg(2));
+	
+	if(!setHistoryTracking(slotID,enabled))
+		return false;
+	
+	okAnswer(answerTo, cParser.getArg(0)) << slotID << CORE_COMMAND_PARAM_DELIMITER << (enabled ? 1 : 0) << ENDLINE;
+	return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::getRuleCommand(const CommandParser& cParser, Stream* answerTo) // GET=RULE returns OK=RULE|count|number|...; GET=RULE|number returns OK=RULE|number|state|hexCode, state is 1, 0 or - (not evaluated yet)
+{
+	if(cParser.argsCount() < 2)
+	{
+		okAnswer(answerTo, cParser.getArg(0)) << rules.getCount();
+		
+		for(uint8_t i=0;i<RULES_MAX_COUNT;i++)
+		{
+			if(rules.exists(i))
+				*answerTo << CORE_COMMAND_PARAM_DELIMITER << i;
+		}
+		
+		*answerTo << ENDLINE;
+		return true;
+	}
+	
+	uint8_t number = atoi(cParser.getArg(1));
+	if(!rules.exists(number))
+		return false;
+	
+	okAnswer(answerTo, cParser.getArg(0)) << number << CORE_COMMAND_PARAM_DELIMITER;
+	
+	if(rules.getState(number) == RULE_STATE_UNKNOWN)
+		*answerTo << '-';
+	else
+		*answerTo << rules.getState(number);
+	
+	*answerTo << CORE_COMMAND_PARAM_DELIMITER;
+	
+	const uint8_t* code = rules.getCode(number);
+	for(uint8_t i=0;i<rules.getLength(number);i++)
+	{
+		if(code[i] < 0x10)
+			*answerTo << '0';
+		
+		answerTo->print(code[i],HEX);
+	}
+	
+	*answerTo << ENDLINE;
+	return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::setRuleCommand(const CommandParser& cParser, Stream* answerTo) // SET=RULE|number|hexCode installs and saves a rule, SET=RULE|number removes it; returns OK=RULE|number|codeLength
+{
+	if(!isNumber(cParser.getArg(1)) || strlen(cParser.getArg(1)) > 3)
+		return false;
+	
+	uint8_t number = atoi(cParser.getArg(1));
+	if(number >= RULES_MAX_COUNT)
+		return false;
+	
+	if(cParser.argsCount() < 3)
+	{
+		// удаляем правило: сначала из хранилища, потом из памяти
+		if(!rules.exists(number) || !ruleStore.remove(number))
+			return false;
+		
+		rules.remove(number);
+		okAnswer(answerTo, cParser.getArg(0)) << number << CORE_COMMAND_PARAM_DELIMITER << 0 << ENDLINE;
+		return true;
+	}
+	
+	// шестнадцатеричная строка, по два символа на байт
+	const char* value = cParser.getArg(2);
+	size_t len = strlen(value);
+	if(len % 2 || len/2 > RULE_MAX_LENGTH)
+		return false;
+	
+	for(size_t i=0;i<len;i++)
+	{
+		if(!isxdigit(value[i]))
+			return false;
+	}
+	
+	uint8_t code[RULE_MAX_LENGTH];
+	uint8_t codeLength = len/2;
+	
+	for(uint8_t i=0;i<codeLength;i++)
+	{
+		char hex[3] = {value[i*2], value[i*2+1], 0};
+		code[i] = strtoul(hex,NULL,16);
+	}
+	
+	// проверяем, сохраняем и только потом ставим: не сохранилось - в памяти остаётся прежнее правило, как и в хранилище
+	if(!RuleEngine::validate(code,codeLength) || !ruleStore.write(number,code,codeLength))
+		return false;
+	
+	rules.set(number,code,codeLength);
+	
+	okAnswer(answerTo, cParser.getArg(0)) << number << CORE_COMMAND_PARAM_DELIMITER << codeLength << ENDLINE;
+	return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::getModulesCommand(const CommandParser& cParser, Stream* answerTo) // GET=MODULES, returns OK=MODULES|count|moduleID|name|online|heardAgo|broadcastSlots|observeSlots|... in one line, heardAgo in milliseconds
+{
+	uint32_t now = uptime();
+	
+	okAnswer(answerTo, cParser.getArg(0)) << modulesList.size();
+	
+	for(size_t i=0;i<modulesList.size();i++)
+	{
+		Module* module = modulesList[i];
+		
+		*answerTo << CORE_COMMAND_PARAM_DELIMITER << module->getID()
+			<< CORE_COMMAND_PARAM_DELIMITER << (module->getName() ? module->getName() : "")
+			<< CORE_COMMAND_PARAM_DELIMITER << (module->isOnline() ? 1 : 0)
+			<< CORE_COMMAND_PARAM_DELIMITER << uint32_t(now - module->getLastHeardAt())
+			<< CORE_COMMAND_PARAM_DELIMITER << module->getBroadcastSlotsCount()
+			<< CORE_COMMAND_PARAM_DELIMITER << module->getObserveSlotsCount();
+	}
+	
+	*answerTo << ENDLINE;
+	return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::writeSlotValue(Stream* answerTo, uint8_t cacheIndex)
+{
+	*answerTo << CORE_COMMAND_PARAM_DELIMITER << slotCache.getSlotID(cacheIndex)
+		<< CORE_COMMAND_PARAM_DELIMITER << slotCache.getModuleID(cacheIndex)
+		<< CORE_COMMAND_PARAM_DELIMITER << slotCache.getDataType(cacheIndex)
+		<< CORE_COMMAND_PARAM_DELIMITER << slotCache.getFlags(cacheIndex)
+		<< CORE_COMMAND_PARAM_DELIMITER << uint32_t(uptime() - slotCache.getUpdatedAt(cacheIndex))
+		<< CORE_COMMAND_PARAM_DELIMITER;
+	
+	const uint8_t* data = slotCache.getData(cacheIndex);
+	for(uint8_t i=0;i<slotCache.getDataLength(cacheIndex);i++)
+	{
+		if(data[i] < 0x10)
+			*answerTo << '0';
+		
+		answerTo->print(data[i],HEX);
+	}
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::writeHistory(Stream* answerTo, SlotHistory* history, uint8_t level)
+{
+	uint32_t now = uptime();
+	uint8_t count = level ? history->getBucketsCount(level) : history->getSamplesCount();
+	
+	*answerTo << history->getSlotID()
+		<< CORE_COMMAND_PARAM_DELIMITER << level
+		<< CORE_COMMAND_PARAM_DELIMITER << SlotHistory::getPeriod(level)
+		<< CORE_COMMAND_PARAM_DELIMITER << count;
+	
+	for(uint8_t i=0;i<count;i++)
+	{
+		if(!level)
+		{
+			const HistorySample& s = history->getSample(i);
+			*answerTo << CORE_COMMAND_PARAM_DELIMITER << uint32_t(now - s.at) << CORE_COMMAND_PARAM_DELIMITER << s.value;
+			continue;
+		}
+		
+		const HistoryBucket& b = history->getBucket(level,i);
+		*answerTo << CORE_COMMAND_PARAM_DELIMITER << uint32_t(now - b.start)
+			<< CORE_COMMAND_PARAM_DELIMITER << b.min
+			<< CORE_COMMAND_PARAM_DELIMITER << b.max
+			<< CORE_COMMAND_PARAM_DELIMITER << b.avg()
+			<< CORE_COMMAND_PARAM_DELIMITER << b.count;
+	}
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::printStats(Stream* answerTo, const char* command, uint8_t transportIndex)
+{
+	TransportStats& st = transports[transportIndex]->getStats();
+	
+	okAnswer(answerTo, command) << transportIndex
+		<< CORE_COMMAND_PARAM_DELIMITER << st.framesRx
+		<< CORE_COMMAND_PARAM_DELIMITER << st.framesTx
+		<< CORE_COMMAND_PARAM_DELIMITER << st.bytesRx
+		<< CORE_COMMAND_PARAM_DELIMITER << st.bytesTx
+		<< CORE_COMMAND_PARAM_DELIMITER << st.resyncs
+		<< CORE_COMMAND_PARAM_DELIMITER << st.packetCrcErrors
+		<< CORE_COMMAND_PARAM_DELIMITER << st.dataCrcErrors
+		<< CORE_COMMAND_PARAM_DELIMITER << st.timeouts
+		<< CORE_COMMAND_PARAM_DELIMITER << st.queueOverflows
+		<< CORE_COMMAND_PARAM_DELIMITER << st.rxOverflows;
+	
+	for(uint8_t i=0;i<STATS_LATENCY_BUCKETS;i++)
+	{
+		*answerTo << CORE_COMMAND_PARAM_DELIMITER << st.latency[i];
+	}
+	
+	*answerTo << ENDLINE;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::printConfigSlot(Stream* answerTo, const char* command, Module* module, uint8_t slotNumber)
+{
+	ModuleConfigSlot* slot = module->getConfigSlot(slotNumber);
+	
+	okAnswer(answerTo, command) << module->getID()
+		<< CORE_COMMAND_PARAM_DELIMITER << slotNumber
+		<< CORE_COMMAND_PARAM_DELIMITER << slot->name
+		<< CORE_COMMAND_PARAM_DELIMITER << static_cast<uint16_t>(slot->type)
+		<< CORE_COMMAND_PARAM_DELIMITER;
+	
+	switch(slot->type)
+	{
+		case ConfigSlotType::Number:
+		{
+			int32_t val;
+			if(slot->dataLength == sizeof(val))
+			{
+				memcpy(&val,slot->data,sizeof(val));
+				*answerTo << val;
+			}
+		}
+		break;
+		
+		case ConfigSlotType::Flag:
+		{
+			if(slot->dataLength)
+				*answerTo << (slot->data[0] ? 1 : 0);
+		}
+		break;
+		
+		case ConfigSlotType::String:
+		{
+			answerTo->write(slot->data,slot->dataLength);
+		}
+		break;
+		
+		case ConfigSlotType::Raw:
+		default:
+		{
+			for(uint16_t i=0;i<slot->dataLength;i++)
+			{
+				if(slot->data[i] < 0x10)
+					*answerTo << '0';
+				
+				answerTo->print(slot->data[i],HEX);
+			}
+		}
+		break;
+	}
+	
+	*answerTo << ENDLINE;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::unknownCommand(Stream* answerTo)
+{
+	*answerTo << CORE_COMMAND_ANSWER_ERROR << F("UNKNOWN_COMMAND") << ENDLINE;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::processBinaryCommand(const uint8_t* payload, uint16_t length, Stream* answerTo)
+{
+	if(!length)
+		return;
+	
+	BinaryFrameWriter writer(*answerTo);
+	
+	uint8_t batch = payload[0];
+	uint16_t pos = 1;
+	uint8_t processed = 0;
+	
+	// запросы пачки: код команды, длина аргументов, аргументы
+	while(pos + 2 <= length)
+	{
+		BinaryCommand command = static_cast<BinaryCommand>(payload[pos]);
+		uint8_t argsLength = payload[pos+1];
+		pos += 2;
+		
+		if(pos + argsLength > length)
+			break; // обрезанный запрос - дальше разбирать нечего
+		
+		if(!binaryCommand(batch,command,payload + pos,argsLength,writer))
+		{
+			writer.begin(batch,command,BinaryStatus::BadArguments,0);
+			writer.end();
+		}
+		
+		pos += argsLength;
+		processed++;
+	}
+	
+	writer.begin(batch,BinaryCommand::End,BinaryStatus::OK,sizeof(processed));
+	writer.write(processed);
+	writer.end();
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SmartController::binaryCommand(uint8_t batch, BinaryCommand command, const uint8_t* args, uint8_t argsLength, BinaryFrameWriter& writer)
+{
+	switch(command)
+	{
+		case BinaryCommand::ID: // ID контроллера (4 байта), длина имени (1 байт), имя
+		{
+			uint8_t nameLength = strlen(name);
+			writer.begin(batch,command,BinaryStatus::OK,sizeof(controllerID) + sizeof(nameLength) + nameLength);
+			writer.write(controllerID);
+			writer.write(nameLength);
+			writer.write(name,nameLength);
+			writer.end();
+		}
+		return true;
+		
+		case BinaryCommand::Uptime: // время работы, секунд (4 байта)
+		{
+			uint32_t seconds = uptime()/1000ul;
+			writer.begin(batch,command,BinaryStatus::OK,sizeof(seconds));
+			writer.write(seconds);
+			writer.end();
+		}
+		return true;
+		
+		case BinaryCommand::Stats: // [индекс транспорта (1 байт)], кадр на каждый транспорт
+		{
+			size_t from = 0, to = transports.size();
+			if(argsLength)
+			{
+				from = args[0];
+				to = from + 1;
+			}
+			
+			if(!(from < to && to <= transports.size()))
+				return false;
+			
+			for(size_t i=from;i<to;i++)
+			{
+				writeBinaryStats(batch,i,writer);
+			}
+		}
+		return true;
+		
+		case BinaryCommand::Config: // ID модуля (1 байт), [номер слота (1 байт)], кадр на каждый вычитанный слот
+		{
+			if(!argsLength)
+				return false;
+			
+			Module* module = findModule(args[0],NULL);
+			
+			if(!module)
+				return false;
+			
+			uint8_t from = 0, to = module->getConfigSlotsCount();
+			if(argsLength > 1)
+			{
+				from = args[1];
+				to = from + 1;
+			}
+			
+			bool handled = false;
+			
+			for(uint8_t i=from;i<to;i++)
+			{
+				ModuleConfigSlot* slot = module->getConfigSlot(i);
+				if(!slot || !slot->loaded)
+					continue;
+				
+				writeBinaryConfigSlot(batch,module,i,writer);
+				handled = true;
+			}
+			
+			return handled;
+		}
+		
+		case BinaryCommand::Subscribe: // мин. интервал, мс (2 байта), [ID слотов, по 2 байта], ответ: кол-во слотов в фильтре (1 байт)
+		{
+			uint16_t minInterval;
+			if(argsLength < sizeof(minInterval))
+				return false;
+			
+			memcpy(&minInterval,args,sizeof(minInterval));
+			Subscription* sub = subscribe(writer.getStream(),minInterval,true,batch);
+			
+			if(!sub)
+				return false;
+			
+			for(uint8_t i=sizeof(minInterval);i+sizeof(uint16_t)<=argsLength;i+=sizeof(uint16_t))
+			{
+				uint16_t slotID;
+				memcpy(&slotID,args + i,sizeof(slotID));
+				sub->addFilter(slotID);
+			}
+			
+			uint8_t filterSize = sub->getFilterSize();
+			writer.begin(batch,command,BinaryStatus::OK,sizeof(filterSize));
+			writer.write(filterSize);
+			writer.end();
+		}
+		return true;
+		
+		case BinaryCommand::Slots: // [ID слотов, по 2 байта], ответ - одним кадром
+		{
+			writeBinarySlots(batch,args,argsLength,writer);
+		}
+		return true;
+		
+		case BinaryCommand::Modules: // ответ - одним кадром
+		{
+			writeBinaryModules(batch,writer);
+		}
+		return true;
+		
+		case BinaryCommand::History: // ID слота (2 байта), уровень (1 байт), ответ - одним кадром
+		{
+			uint16_t slotID;
+			if(argsLength < sizeof(slotID) + 1)
+				return false;
+			
+			memcpy(&slotID,args,sizeof(slotID));
+			SlotHistory* history = findHistory(slotID);
+			uint8_t level = args[sizeof(slotID)];
+			
+			if(!history || level > HISTORY_ROLLUP_LEVELS)
+				return false;
+			
+			writeBinaryHistory(batch,history,level,writer);
+		}
+		return true;
+		
+		case BinaryCommand::Unsubscribe:
+		{
+			if(!unsubscribe(writer.getStream()))
+				return false;
+			
+			writer.begin(batch,command,BinaryStatus::OK,0);
+			writer.end();
+		}
+		return true;
+		
+		default:
+		{
+			writer.begin(batch,command,BinaryStatus::UnknownCommand,0);
+			writer.end();
+		}
+		return true;
+	}
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::writeBinaryStats(uint8_t batch, uint8_t transportIndex, BinaryFrameWriter& writer)
+{
+	TransportStats& st = transports[transportIndex]->getStats();
+	
+	// счётчики статистики - подряд, как они лежат в TransportStats и в порядке GET=STATS
+	const uint8_t COUNTERS = 10;
+	uint32_t counters[COUNTERS] = {st.framesRx, st.framesTx, st.bytesRx, st.bytesTx, st.resyncs,
+		st.packetCrcErrors, st.dataCrcErrors, st.timeouts, st.queueOverflows, st.rxOverflows};
+	
+	writer.begin(batch,BinaryCommand::Stats,BinaryStatus::OK,sizeof(transportIndex) + sizeof(counters) + sizeof(st.latency));
+	writer.write(transportIndex);
+	writer.write(counters,sizeof(counters));
+	writer.write(st.latency,sizeof(st.latency));
+	writer.end();
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::writeBinarySlots(uint8_t batch, const uint8_t* args, uint8_t argsLength, BinaryFrameWriter& writer)
+{
+	// без аргументов - все слоты из кэша, неизвестные слоты в ответ не попадают
+	uint8_t requested = argsLength/sizeof(uint16_t);
+	uint8_t total = requested ? requested : slotCache.size();
+	
+	// длина кадра нужна заранее - первым проходом считаем, сколько слотов попадёт в ответ
+	uint8_t count = 0;
+	uint16_t dataLength = sizeof(count);
+	
+	for(uint8_t pass=0;pass<2;pass++)
+	{
+		if(pass)
+		{
+			writer.begin(batch,BinaryCommand::Slots,BinaryStatus::OK,dataLength);
+			writer.write(count);
+		}
+		
+		for(uint8_t i=0;i<total;i++)
+		{
+			uint8_t idx = i;
+			
+			if(requested)
+			{
+				uint16_t slotID;
+				memcpy(&slotID,args + i*sizeof(slotID),sizeof(slotID));
+				idx = slotCache.find(slotID);
+			}
+			
+			if(idx == SLOT_CACHE_NO_INDEX)
+				continue;
+			
+			if(!pass)
+				count++;
+			
+			writeBinarySlotValue(idx,pass ? &writer : NULL,dataLength);
+		}
+	}
+	
+	writer.end();
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::writeBinarySlotValue(uint8_t cacheIndex, BinaryFrameWriter* writer, uint16_t& dataLength)
+{
+	// ID слота (2 байта), ID модуля (1 байт), тип данных (2 байта), флаги (1 байт), возраст, мс (4 байта), длина данных (1 байт), данные
+	uint8_t valueLength = slotCache.getDataLength(cacheIndex);
+	
+	if(!writer)
+	{
+		// только считаем длину
+		dataLength += 2 + 1 + 2 + 1 + 4 + 1 + valueLength;
+		return;
+	}
+	
+	writer->write(slotCache.getSlotID(cacheIndex));
+	writer->write(slotCache.getModuleID(cacheIndex));
+	writer->write(uint16_t(slotCache.getDataType(cacheIndex)));
+	writer->write(slotCache.getFlags(cacheIndex));
+	writer->write(uint32_t(uptime() - slotCache.getUpdatedAt(cacheIndex)));
+	writer->write(valueLength);
+	writer->write(slotCache.getData(cacheIndex),valueLength);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::writeBinaryModules(uint8_t batch, BinaryFrameWriter& writer)
+{
+	uint32_t now = uptime();
+	uint8_t count = modulesList.size();
+	uint16_t dataLength = sizeof(count);
+	
+	// ID, на связи, сколько назад слышали, исходящих и входящих слотов, длина имени, имя
+	for(uint8_t i=0;i<count;i++)
+	{
+		const char* nm = modulesList[i]->getName();
+		dataLength += 1 + 1 + sizeof(uint32_t) + 1 + 1 + 1 + (nm ? strlen(nm) : 0);
+	}
+	
+	writer.begin(batch,BinaryCommand::Modules,BinaryStatus::OK,dataLength);
+	writer.write(count);
+	
+	for(uint8_t i=0;i<count;i++)
+	{
+		Module* module = modulesList[i];
+		const char* nm = module->getName();
+		uint8_t nameLength = nm ? strlen(nm) : 0;
+		
+		writer.write(module->getID());
+		writer.write(uint8_t(module->isOnline() ? 1 : 0));
+		writer.write(uint32_t(now - module->getLastHeardAt()));
+		writer.write(module->getBroadcastSlotsCount());
+		writer.write(module->getObserveSlotsCount());
+		writer.write(nameLength);
+		writer.write(nm,nameLength);
+	}
+	
+	writer.end();
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::writeBinaryHistory(uint8_t batch, SlotHistory* history, uint8_t level, BinaryFrameWriter& writer)
+{
+	uint32_t now = uptime();
+	uint8_t count = level ? history->getBucketsCount(level) : history->getSamplesCount();
+	
+	// ID слота, уровень, длительность интервала, кол-во записей; запись: возраст и значение или min, max, среднее, кол-во значений
+	uint16_t entryLength = level ? (4 + 4*3 + 2) : (4 + 4);
+	
+	writer.begin(batch,BinaryCommand::History,BinaryStatus::OK,2 + 1 + 4 + 1 + count*entryLength);
+	writer.write(history->getSlotID());
+	writer.write(level);
+	writer.write(SlotHistory::getPeriod(level));
+	writer.write(count);
+	
+	for(uint8_t i=0;i<count;i++)
+	{
+		if(!level)
+		{
+			const HistorySample& s = history->getSample(i);
+			writer.write(uint32_t(now - s.at));
+			writer.write(s.value);
+			continue;
+		}
+		
+		const HistoryBucket& b = history->getBucket(level,i);
+		writer.write(uint32_t(now - b.start));
+		writer.write(b.min);
+		writer.write(b.max);
+		writer.write(b.avg());
+		writer.write(b.count);
+	}
+	
+	writer.end();
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SmartController::writeBinaryConfigSlot(uint8_t batch, Module* module, uint8_t slotNumber, BinaryFrameWriter& writer)
+{
+	ModuleConfigSlot* slot = module->getConfigSlot(slotNumber);
+	uint8_t moduleID = module->getID();
+	uint16_t type = static_cast<uint16_t>(slot->type);
+	
+	writer.begin(batch,BinaryCommand::Config,BinaryStatus::OK,sizeof(moduleID) + sizeof(slotNumber) + sizeof(type) + sizeof(slot->dataLength) + slot->dataLength);
+	writer.write(moduleID);
+	writer.write(slotNumber);
+	writer.write(type);
+	writer.write(slot->dataLength);
+	writer.write(slot->data,slot->dataLength);
+	writer.end();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 Stream& SmartController::okAnswer(Stream* answerTo, const char* command)
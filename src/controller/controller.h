@@ -5,13 +5,22 @@
 #include "../config.h"
 #include <stddef.h>
 #include "streamlistener.h"
+#include "binaryprotocol.h"
+#include "slotcache.h"
+#include "subscription.h"
+#include "history.h"
+#include "../rules/rules.h"
+#include "../storage/recordstore.h"
 #include "../storage/storage.h"
 #include "../transport/transport.h"
 #include "../message/message.h"
 #include "../data/anydata.h"
+#include "../transport/tdma.h"
+#include "bridge.h"
 //--------------------------------------------------------------------------------------------------------------------------------------
 typedef Vector<StreamListener*> ListenersList;
 typedef Vector<Transport*> TransportsList;
+typedef Vector<TDMASchedule> SchedulesList;
 //--------------------------------------------------------------------------------------------------------------------------------------
 // состояния конечного автомата работы контроллера
 enum class SmartControllerState
@@ -28,6 +37,26 @@ enum class ScanState
 	WaitForModuleAnswer
 };
 //--------------------------------------------------------------------------------------------------------------------------------------
+// состояния конечного автомата опроса конфигурации модулей
+enum class AskSlotsState
+{
+	AskConfiguration, // запрашиваем у модуля кол-во слотов конфигурации
+	WaitConfiguration,
+	AskConfigSlot, // запрашиваем очередной слот конфигурации
+	WaitConfigSlot
+};
+//--------------------------------------------------------------------------------------------------------------------------------------
+// слот конфигурации модуля, закэшированный контроллером - консоль читает его без обращения к шине
+typedef struct
+{
+	char* name;
+	ConfigSlotType type;
+	uint8_t* data;
+	uint16_t dataLength;
+	bool loaded; // слот вычитан с модуля
+	
+} ModuleConfigSlot;
+//--------------------------------------------------------------------------------------------------------------------------------------
 // информация о модуле в системе
 class Module
 {
@@ -47,12 +76,70 @@ class Module
 		void setBroadcastSlotsCount(uint8_t cnt) { broadcastSlotsCount = cnt; }
 		uint8_t getBroadcastSlotsCount() { return broadcastSlotsCount; }
 		
+		// модуль на связи?
+		bool isOnline() { return online; }
+		
+		// когда последний раз слышали модуль
+		uint32_t getLastHeardAt() { return lastHeardAt; }
+		
+		// от модуля пришёл любой фрейм, возвращает true, если модуль вернулся на связь
+		bool heard();
+		
+		// пора ли пинговать модуль?
+		bool needPing();
+		
+		// модуль пропинговали, возвращает true, если после этого модуль пропал со связи
+		bool pinged();
+		
+		// ждём ответа на пинг, отосланный в момент getLastPingAt()
+		bool isPingPending() { return pingPending; }
+		uint32_t getLastPingAt() { return lastPingAt; }
+		
+		// опрос модуля: сначала регистрируем его исходящие слоты (в ответ модуль присылает их данные),
+		// потом периодически запрашиваем события, и по событию SlotDataChanged - данные изменившегося слота
+		bool needDataRequest() { return dataRequestPending; }
+		uint16_t dataRequested() { dataRequestPending = false; return requestSlotID; } // возвращает ID слота, данные которого запрошены
+		bool needSlotRegistration() { return nextSlotToRegister < broadcastSlotsCount; }
+		uint8_t slotRegistrationRequested() { return nextSlotToRegister++; } // возвращает номер регистрируемого слота
+		bool needEventRequest();
+		void eventRequested();
+		void eventReceived(const Message& m);
+		
+		// в каком кадре расписания модуль опрашивали последний раз - не чаще раза за кадр, ответ придёт в слот модуля
+		uint32_t getPollFrame() { return pollFrame; }
+		void setPollFrame(uint32_t frameStart) { pollFrame = frameStart; }
+		
+		// кэш слотов конфигурации модуля
+		void setConfigSlotsCount(uint8_t cnt);
+		uint8_t getConfigSlotsCount() { return configSlotsCount; }
+		ModuleConfigSlot* getConfigSlot(uint8_t idx) { return idx < configSlotsCount ? &(configSlots[idx]) : NULL; }
+		void setConfigSlot(uint8_t idx, ConfigSlotType type, const char* nm, uint8_t nameLen, const uint8_t* data, uint16_t dataLength);
+		void setConfigSlotData(uint8_t idx, const uint8_t* data, uint16_t dataLength);
+		
 	private:
 	
 		uint8_t moduleID; // ID модуля
 		Transport* transport; // транспорт для модуля
 		char* moduleName;
 		uint8_t observeSlotsCount, broadcastSlotsCount;
+		
+		uint32_t lastHeardAt; // когда последний раз получали от модуля что-либо
+		uint32_t lastPingAt; // когда последний раз пинговали модуль
+		uint32_t pingInterval; // текущий интервал между пингами, растёт вдвое с каждым пингом без ответа
+		uint8_t missedPings; // кол-во пингов без ответа подряд
+		bool pingPending; // ждём ответа на пинг
+		bool online;
+		
+		uint8_t nextSlotToRegister; // номер следующего исходящего слота, который надо зарегистрировать
+		uint32_t lastEventRequestAt; // когда последний раз запрашивали события
+		bool moreEvents; // на последний запрос модуль прислал событие - у него могут быть ещё
+		uint16_t requestSlotID; // ID слота, данные которого надо запросить
+		bool dataRequestPending;
+		uint32_t pollFrame;
+		
+		ModuleConfigSlot* configSlots;
+		uint8_t configSlotsCount;
+		void clearConfig();
 	
 		//TODO: тут будет другая информация, типа слотов для модуля
 	
@@ -64,6 +151,37 @@ class Module
 //--------------------------------------------------------------------------------------------------------------------------------------
 typedef Vector<Module*> SmartModulesList;
 //--------------------------------------------------------------------------------------------------------------------------------------
+// сохранение слота конфигурации, ожидающее отправки на модуль или подтверждения от него
+typedef struct
+{
+	Module* module;
+	uint8_t slotNumber;
+	uint8_t* data;
+	uint16_t dataLength;
+	uint32_t sentAt;
+	bool sent;
+	
+} PendingConfigSave;
+//--------------------------------------------------------------------------------------------------------------------------------------
+typedef Vector<PendingConfigSave> PendingConfigSavesList;
+//--------------------------------------------------------------------------------------------------------------------------------------
+class SmartController;
+class CommandParser;
+//--------------------------------------------------------------------------------------------------------------------------------------
+// обработчик команды, возвращает false, если команду выполнить не удалось (в ответ уйдёт ошибка)
+typedef bool (SmartController::*CommandHandler)(const CommandParser& cParser, Stream* answerTo);
+//--------------------------------------------------------------------------------------------------------------------------------------
+// описание команды в таблице команд (таблица хранится во флеше)
+typedef struct
+{
+	const char* name; // имя команды, во флеше
+	CommandHandler getHandler; // обработчик GET=, NULL - команду нельзя читать
+	uint8_t getMinArgs; // сколько аргументов, кроме имени, как минимум нужно для GET=
+	CommandHandler setHandler; // обработчик SET=, NULL - команду нельзя устанавливать
+	uint8_t setMinArgs; // сколько аргументов, кроме имени, как минимум нужно для SET=
+	
+} CommandDescriptor;
+//--------------------------------------------------------------------------------------------------------------------------------------
 class SmartController
 {
 	public:
@@ -81,6 +199,12 @@ class SmartController
 		uint32_t getID() { return controllerID; }
 		const char* getName() { return name; }
 		
+		// режим моста: данные слотов, пришедшие с одного транспорта, пересылаются в остальные транспорты
+		// ID модулей должны быть уникальны среди всех транспортов: дубликаты при сканировании не регистрируются,
+		// а данные модуля, ID которого есть и на другом транспорте, не пересылаются
+		void setBridgeMode(bool enabled) { bridgeMode = enabled; }
+		bool getBridgeMode() { return bridgeMode; }
+		
 		uint8_t getModulesCount() { return modulesList.size(); }
 		Module* getModule(uint8_t idx) { return modulesList[idx]; }
 		
@@ -93,8 +217,11 @@ class SmartController
 		
 		void askSlots();
 		void updateAskSlots();
+		void askNextModuleSlots();
 		
 		ScanState scanState;
+		AskSlotsState askSlotsState;
+		uint8_t currentConfigSlot;
 		uint8_t currentTransportIndex;
 		uint8_t currentModuleIndex;
 		uint32_t timer, timeout;
@@ -110,12 +237,100 @@ class SmartController
 		TransportsList transports;
 		void updateTransports();
 		
+		SchedulesList schedules; // расписания доступа к шине, по одному на транспорт
+		void updateNormal();
+		void updateBeacons();
+		void sendBeacon(uint8_t transportIndex);
+		bool canTransmit(uint8_t transportIndex) { return schedules[transportIndex].canTransmit(); }
+		uint8_t getTransportIndex(Transport* t);
+		
+		void processIncoming();
+		void processIncomingMessage(uint8_t transportIndex, const Message& m);
+		Module* findModule(uint8_t moduleID, Transport* t);
+		
+		void updateLiveness();
+		void updatePolling();
+		void publishOnlineModules();
+		uint32_t onlineListPending; // битовая маска транспортов, в которые надо отослать список онлайн-модулей
+		
+		Bridge bridge; // исходящие очереди режима моста
+		bool bridgeMode;
+		void relaySlotData(uint8_t transportIndex, const Message& m);
+		void updateBridge();
+		
+		PendingConfigSavesList pendingConfigSaves; // сохранения слотов конфигурации, отсылаемые модулям в нашем окне расписания
+		void cacheConfigSlot(Module* module, const Message& m);
+		void configSlotSaved(Module* module, const Message& m);
+		void updateConfigSaves();
+		void clearConfigSaves();
+		void removeConfigSave(size_t idx);
+		
+		SubscriptionsList subscriptions; // подписки потоков консоли на данные слотов
+		Subscription* subscribe(Stream* s, uint16_t minInterval, bool binary, uint8_t batch);
+		Subscription* findSubscription(Stream* s);
+		bool unsubscribe(Stream* s);
+		void publishSlotData(uint8_t cacheIndex, bool evicted);
+		void slotDataReceived(const Message& m); // данные слота из BroadcastSlotData, AnyDataResponse или от правил контроллера
+		
+		SlotCache slotCache; // последние значения слотов - консоль и подписки читают их без обращения к шине
+		void writeSlotValue(Stream* answerTo, uint8_t cacheIndex);
+		void writeBinarySlotValue(uint8_t cacheIndex, BinaryFrameWriter* writer, uint16_t& dataLength);
+		
+		SlotHistoriesList histories; // истории значений выбранных слотов
+		SlotHistory* findHistory(uint16_t slotID);
+		void recordHistory(uint8_t cacheIndex);
+		bool setHistoryTracking(uint16_t slotID, bool enabled);
+		void writeHistory(Stream* answerTo, SlotHistory* history, uint8_t level);
+		void writeBinaryHistory(uint8_t batch, SlotHistory* history, uint8_t level, BinaryFrameWriter& writer);
+		void updateSubscriptions();
+		
+		RuleEngine rules; // правила, значения слотов берут из кэша
+		RecordStore ruleStore; // правила в хранилище, ключ записи - номер правила
+		uint32_t ruleOutputs[RULES_MAX_COUNT]; // по правилам: битовая маска транспортов, в которые ещё надо отослать данные целевого слота
+		uint32_t rulesResentAt; // когда последний раз повторяли данные всех правил
+		void loadRules();
+		void updateRules();
+		void resendRuleOutputs(uint32_t transportsMask);
+		
 		ListenersList listeners;
 		void handleIncomingCommands();
-		void processCommand(const String& command, Stream* answerTo);
-		void setCommand(const String& command, Stream* answerTo);
-		void getCommand(const String& command, Stream* answerTo);
+		static bool commandStartsWith(const char* command, const __FlashStringHelper* prefix);
+		static bool isNumber(const char* arg); // аргумент команды - целое число без знака
+		void processCommand(char* command, Stream* answerTo);
 		void unknownCommand(Stream* answerTo);
+		
+		void processBinaryCommand(const uint8_t* payload, uint16_t length, Stream* answerTo);
+		bool binaryCommand(uint8_t batch, BinaryCommand command, const uint8_t* args, uint8_t argsLength, BinaryFrameWriter& writer);
+		void writeBinaryStats(uint8_t batch, uint8_t transportIndex, BinaryFrameWriter& writer);
+		void writeBinaryConfigSlot(uint8_t batch, Module* module, uint8_t slotNumber, BinaryFrameWriter& writer);
+		void writeBinarySlots(uint8_t batch, const uint8_t* args, uint8_t argsLength, BinaryFrameWriter& writer);
+		void writeBinaryModules(uint8_t batch, BinaryFrameWriter& writer);
+		
+		static const CommandDescriptor commands[];
+		static const uint8_t COMMANDS_COUNT;
+		bool findCommand(const char* commandName, CommandDescriptor& result);
+		
+		bool getIDCommand(const CommandParser& cParser, Stream* answerTo);
+		bool getUptimeCommand(const CommandParser& cParser, Stream* answerTo);
+		bool getStatsCommand(const CommandParser& cParser, Stream* answerTo);
+	#ifdef USE_PROFILER
+		bool getProfileCommand(const CommandParser& cParser, Stream* answerTo);
+	#endif
+		bool getConfigCommand(const CommandParser& cParser, Stream* answerTo);
+		bool setConfigCommand(const CommandParser& cParser, Stream* answerTo);
+		bool getSubscribeCommand(const CommandParser& cParser, Stream* answerTo);
+		bool setSubscribeCommand(const CommandParser& cParser, Stream* answerTo);
+		bool setUnsubscribeCommand(const CommandParser& cParser, Stream* answerTo);
+		bool getSlotsCommand(const CommandParser& cParser, Stream* answerTo);
+		bool getHistoryCommand(const CommandParser& cParser, Stream* answerTo);
+		bool setHistoryCommand(const CommandParser& cParser, Stream* answerTo);
+		bool getModulesCommand(const CommandParser& cParser, Stream* answerTo);
+		bool getRuleCommand(const CommandParser& cParser, Stream* answerTo);
+		bool setRuleCommand(const CommandParser& cParser, Stream* answerTo);
+		
+		void printStats(Stream* answerTo, const char* command, uint8_t transportIndex);
+		void printConfigSlot(Stream* answerTo, const char* command, Module* module, uint8_t slotNumber);
+		bool queueConfigSave(Module* module, uint8_t slotNumber, const char* value);
 		Stream& okAnswer(Stream* answerTo, const char* command);
 	
 };
@@ -0,0 +1,70 @@
+#include "history.h"
+#include "../utils/uptime.h"
+//--------------------------------------------------------------------------------------------------------------------------------------
+// SlotHistory
+//--------------------------------------------------------------------------------------------------------------------------------------
+SlotHistory::SlotHistory(uint16_t id)
+{
+	slotID = id;
+	samplesHead = samplesCount = 0;
+
+	for(uint8_t i=0;i<HISTORY_ROLLUP_LEVELS;i++)
+	{
+		bucketsHead[i] = bucketsCount[i] = 0;
+	}
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+const uint32_t SlotHistory::periods[HISTORY_ROLLUP_LEVELS] = { HISTORY_LEVEL1_PERIOD, HISTORY_LEVEL2_PERIOD };
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SlotHistory::add(int32_t value)
+{
+	uint32_t now = uptime();
+
+	// сырое значение - в кольцо, самое старое при переполнении затирается
+	if(samplesCount < HISTORY_RAW_SAMPLES)
+		samplesCount++;
+	else
+		samplesHead = (samplesHead + 1) % HISTORY_RAW_SAMPLES;
+
+	HistorySample* s = &(samples[(samplesHead + samplesCount - 1) % HISTORY_RAW_SAMPLES]);
+	s->at = now;
+	s->value = value;
+
+	// и сразу - во все уровни огрубления
+	for(uint8_t level=1;level<=HISTORY_ROLLUP_LEVELS;level++)
+	{
+		uint32_t period = getPeriod(level);
+		uint32_t start = now - now % period;
+		uint8_t li = level - 1;
+
+		HistoryBucket* b = bucketsCount[li] ? &(buckets[li][(bucketsHead[li] + bucketsCount[li] - 1) % HISTORY_BUCKETS]) : NULL;
+
+		if(!b || b->start != start)
+		{
+			// начался новый интервал
+			if(bucketsCount[li] < HISTORY_BUCKETS)
+				bucketsCount[li]++;
+			else
+				bucketsHead[li] = (bucketsHead[li] + 1) % HISTORY_BUCKETS;
+
+			b = &(buckets[li][(bucketsHead[li] + bucketsCount[li] - 1) % HISTORY_BUCKETS]);
+			b->start = start;
+			b->min = b->max = value;
+			b->sum = 0;
+			b->count = 0;
+		}
+
+		if(value < b->min)
+			b->min = value;
+
+		if(value > b->max)
+			b->max = value;
+
+		if(b->count < 0xFFFF)
+		{
+			b->sum += value;
+			b->count++;
+		}
+	}
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Arduino.h>
+#include "../utils/vector.h"
+#include "../config.h"
+#include <stddef.h>
+//--------------------------------------------------------------------------------------------------------------------------------------
+#define HISTORY_ROLLUP_LEVELS 2 // уровней огрубления, не считая сырых значений (уровень 0)
+//--------------------------------------------------------------------------------------------------------------------------------------
+// длительность интервала каждого уровня задаётся в config.h: HISTORY_LEVEL1_PERIOD, HISTORY_LEVEL2_PERIOD
+#if HISTORY_ROLLUP_LEVELS != 2
+	#error "HISTORY_ROLLUP_LEVELS must match the HISTORY_LEVELn_PERIOD defines and SlotHistory::periods"
+#endif
+//--------------------------------------------------------------------------------------------------------------------------------------
+// значение слота, как оно пришло
+typedef struct
+{
+	uint32_t at; // когда пришло, по uptime()
+	int32_t value;
+
+} HistorySample;
+//--------------------------------------------------------------------------------------------------------------------------------------
+// интервал огрубления: все значения, пришедшие за интервал, свёрнуты в min/max/сумму
+typedef struct
+{
+	uint32_t start; // начало интервала, по uptime(), кратно длительности интервала
+	int32_t min;
+	int32_t max;
+	int64_t sum; // до 65535 значений - в 32 битах не помещается
+	uint16_t count;
+
+	int32_t avg() const { return count ? int32_t(sum/count) : 0; }
+
+} HistoryBucket;
+//--------------------------------------------------------------------------------------------------------------------------------------
+// история одного слота в памяти фиксированного размера: кольцо последних значений и кольца интервалов
+// на каждом уровне огрубления. Каждое значение сразу сворачивается во все уровни, поэтому старые сырые значения
+// можно выбрасывать, ничего не теряя в огрублённой истории.
+//--------------------------------------------------------------------------------------------------------------------------------------
+class SlotHistory
+{
+	public:
+		SlotHistory(uint16_t slotID);
+
+		uint16_t getSlotID() { return slotID; }
+
+		void add(int32_t value);
+
+		// сырые значения, 0 - самое старое
+		uint8_t getSamplesCount() { return samplesCount; }
+		const HistorySample& getSample(uint8_t idx) { return samples[(samplesHead + idx) % HISTORY_RAW_SAMPLES]; }
+
+		// интервалы уровня level (1..HISTORY_ROLLUP_LEVELS), 0 - самый старый, последний - ещё не закрытый
+		uint8_t getBucketsCount(uint8_t level) { return bucketsCount[level-1]; }
+		const HistoryBucket& getBucket(uint8_t level, uint8_t idx) { return buckets[level-1][(bucketsHead[level-1] + idx) % HISTORY_BUCKETS]; }
+		static uint32_t getPeriod(uint8_t level) { return (level >= 1 && level <= HISTORY_ROLLUP_LEVELS) ? periods[level-1] : 0; }
+
+	private:
+
+		static const uint32_t periods[HISTORY_ROLLUP_LEVELS];
+
+		uint16_t slotID;
+
+		HistorySample samples[HISTORY_RAW_SAMPLES];
+		uint8_t samplesHead, samplesCount;
+
+		HistoryBucket buckets[HISTORY_ROLLUP_LEVELS][HISTORY_BUCKETS];
+		uint8_t bucketsHead[HISTORY_ROLLUP_LEVELS], bucketsCount[HISTORY_ROLLUP_LEVELS];
+
+		SlotHistory(const SlotHistory& rhs);
+		SlotHistory& operator=(const SlotHistory& rhs);
+};
+//--------------------------------------------------------------------------------------------------------------------------------------
+typedef Vector<SlotHistory*> SlotHistoriesList;
+//--------------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,132 @@
+#include "slotcache.h"
+#include "../utils/uptime.h"
+#include "../data/anydata.h"
+//--------------------------------------------------------------------------------------------------------------------------------------
+// SlotCache
+//--------------------------------------------------------------------------------------------------------------------------------------
+SlotCache::SlotCache()
+{
+	count = 0;
+	memset(index,0,sizeof(index));
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+uint8_t SlotCache::find(uint16_t slotID)
+{
+	uint8_t pos = hash(slotID);
+
+	// индекс всегда больше кэша, поэтому свободная ячейка найдётся
+	while(index[pos])
+	{
+		uint8_t idx = index[pos] - 1;
+		if(slotIDs[idx] == slotID)
+			return idx;
+
+		pos = (pos + 1) & (SLOT_CACHE_INDEX_SIZE - 1);
+	}
+
+	return SLOT_CACHE_NO_INDEX;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SlotCache::addToIndex(uint8_t idx)
+{
+	uint8_t pos = hash(slotIDs[idx]);
+
+	while(index[pos])
+		pos = (pos + 1) & (SLOT_CACHE_INDEX_SIZE - 1);
+
+	index[pos] = idx + 1;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SlotCache::rebuildIndex()
+{
+	// из открытой адресации просто так не удалишь - перестраиваем индекс целиком, это бывает только при вытеснении
+	memset(index,0,sizeof(index));
+
+	for(uint8_t i=0;i<count;i++)
+		addToIndex(i);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+uint8_t SlotCache::findOldest()
+{
+	uint32_t now = uptime();
+	uint8_t oldest = 0;
+
+	for(uint8_t i=1;i<count;i++)
+	{
+		if(now - updatedAt[i] > now - updatedAt[oldest])
+			oldest = i;
+	}
+
+	return oldest;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+uint8_t SlotCache::update(const Message& m, bool& evicted)
+{
+	// нагрузка: ID слота (2 байта), тип данных (2 байта), флаги (1 байт), длина данных (2 байта), данные
+	const uint16_t DATA_OFFSET = 7;
+
+	evicted = false;
+
+	if(m.getPayloadLength() < MESSAGE_HEADER_SIZE + DATA_OFFSET)
+		return SLOT_CACHE_NO_INDEX;
+
+	uint16_t dataLength = m.get<uint16_t>(5);
+	if(dataLength > SLOT_DATA_MAX_LENGTH || m.getPayloadLength() < MESSAGE_HEADER_SIZE + DATA_OFFSET + dataLength)
+		return SLOT_CACHE_NO_INDEX;
+
+	uint16_t slotID = m.get<uint16_t>(0);
+	uint8_t idx = find(slotID);
+
+	if(idx == SLOT_CACHE_NO_INDEX)
+	{
+		if(count < SLOT_CACHE_SIZE)
+		{
+			idx = count++;
+			slotIDs[idx] = slotID;
+			addToIndex(idx);
+		}
+		else
+		{
+			idx = findOldest();
+			slotIDs[idx] = slotID;
+			rebuildIndex();
+			evicted = true;
+		}
+	}
+
+	moduleIDs[idx] = m.moduleID;
+	dataTypes[idx] = m.get<uint16_t>(2);
+	flags[idx] = m.get<uint8_t>(4) & ~SLOT_FLAG_STALE;
+	dataLengths[idx] = dataLength;
+	updatedAt[idx] = uptime();
+	memcpy(values[idx],m.get(DATA_OFFSET),dataLength);
+
+	return idx;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void SlotCache::markStale(const Message& m)
+{
+	// Event: ID модуля (1 байт), тип события (2 байта), длина данных (2 байта), данные;
+	// EventResponse: флаг наличия события (1 байт), дальше - так же.
+	// Данные события SlotDataChanged: ID модуля (1 байт), ID слота (2 байта)
+	if(m.type == Messages::EventResponse && !m.get<uint8_t>(0))
+		return;
+
+	if(m.getPayloadLength() < MESSAGE_HEADER_SIZE + 5 + 3 || static_cast<Events>(m.get<uint16_t>(1)) != Events::SlotDataChanged)
+		return;
+
+	uint8_t idx = find(m.get<uint16_t>(6));
+
+	if(idx != SLOT_CACHE_NO_INDEX)
+		flags[idx] |= SLOT_FLAG_STALE;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool SlotCache::getSlotValue(uint16_t slotID, int32_t& result)
+{
+	uint8_t idx = find(slotID);
+	if(idx == SLOT_CACHE_NO_INDEX)
+		return false;
+
+	return AnyData::toNumber(static_cast<DataType>(dataTypes[idx]),values[idx],dataLengths[idx],result);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
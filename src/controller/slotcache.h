@@ -0,0 +1,73 @@
+#pragma once
+
+#include <Arduino.h>
+#include "../config.h"
+#include "../message/message.h"
+#include "../rules/rules.h"
+#include <stddef.h>
+//--------------------------------------------------------------------------------------------------------------------------------------
+#if SLOT_CACHE_SIZE > 254 || SLOT_CACHE_INDEX_SIZE <= SLOT_CACHE_SIZE || (SLOT_CACHE_INDEX_SIZE & (SLOT_CACHE_INDEX_SIZE - 1)) || SLOT_CACHE_INDEX_SIZE > 256
+	#error "SLOT_CACHE_SIZE must be <= 254, SLOT_CACHE_INDEX_SIZE must be a power of two, greater than SLOT_CACHE_SIZE and <= 256"
+#endif
+//--------------------------------------------------------------------------------------------------------------------------------------
+#define SLOT_CACHE_NO_INDEX 0xFF // такого слота в кэше нет
+#define SLOT_FLAG_STALE 0x80 // бит флагов слота в кэше: модуль сообщил, что значение изменилось, а новое ещё не пришло
+//--------------------------------------------------------------------------------------------------------------------------------------
+// кэш последних значений слотов на контроллере. Поля записей лежат отдельными массивами (ID слотов - подряд,
+// типы - подряд и т.д.), поэтому перебор по одному полю не таскает за собой остальные, а поиск записи по ID слота
+// идёт через хэш-индекс за постоянное время. Индекс записи не меняется, пока её не отберёт другой слот.
+// Кэш же - источник значений слотов для правил контроллера.
+//--------------------------------------------------------------------------------------------------------------------------------------
+class SlotCache : public RuleInputs
+{
+	public:
+		SlotCache();
+
+		uint8_t size() { return count; }
+
+		// возвращает индекс записи слота или SLOT_CACHE_NO_INDEX
+		uint8_t find(uint16_t slotID);
+
+		// запоминает данные слота из сообщения BroadcastSlotData или AnyDataResponse, возвращает индекс записи или SLOT_CACHE_NO_INDEX.
+		// Если кэш полон - запись отбирается у слота, который дольше всех не обновлялся, и evicted выставляется в true
+		uint8_t update(const Message& m, bool& evicted);
+
+		// событие SlotDataChanged из сообщения Event или EventResponse: значение в кэше устарело
+		void markStale(const Message& m);
+
+		// поля записи по её индексу
+		uint16_t getSlotID(uint8_t idx) { return slotIDs[idx]; }
+		uint8_t getModuleID(uint8_t idx) { return moduleIDs[idx]; }
+		uint8_t getDataType(uint8_t idx) { return dataTypes[idx]; }
+		uint8_t getFlags(uint8_t idx) { return flags[idx]; } // флаги AnyData и SLOT_FLAG_STALE
+		bool hasData(uint8_t idx) { return flags[idx] & 1; } // AnyDataFlags::hasData - младший бит
+		uint32_t getUpdatedAt(uint8_t idx) { return updatedAt[idx]; }
+		uint8_t getDataLength(uint8_t idx) { return dataLengths[idx]; }
+		const uint8_t* getData(uint8_t idx) { return values[idx]; }
+
+		bool getSlotValue(uint16_t slotID, int32_t& result);
+
+	private:
+
+		uint8_t count;
+
+		uint16_t slotIDs[SLOT_CACHE_SIZE];
+		uint8_t moduleIDs[SLOT_CACHE_SIZE];
+		uint8_t dataTypes[SLOT_CACHE_SIZE];
+		uint8_t flags[SLOT_CACHE_SIZE];
+		uint8_t dataLengths[SLOT_CACHE_SIZE];
+		uint32_t updatedAt[SLOT_CACHE_SIZE];
+		uint8_t values[SLOT_CACHE_SIZE][SLOT_DATA_MAX_LENGTH];
+
+		// хэш-индекс с линейным пробированием: индекс записи + 1, 0 - свободная ячейка
+		uint8_t index[SLOT_CACHE_INDEX_SIZE];
+
+		static uint8_t hash(uint16_t slotID) { return (slotID ^ (slotID >> 8)) & (SLOT_CACHE_INDEX_SIZE - 1); }
+		void addToIndex(uint8_t idx);
+		void rebuildIndex();
+		uint8_t findOldest();
+
+		SlotCache(const SlotCache& rhs);
+		SlotCache& operator=(const SlotCache& rhs);
+};
+//--------------------------------------------------------------------------------------------------------------------------------------
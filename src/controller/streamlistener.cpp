@@ -1,105 +1,290 @@
 #include "streamlistener.h"
+#include "../utils/crc8.h"
+#include "../utils/uptime.h"
 //--------------------------------------------------------------------------------------------------------------------------------------
 StreamListener::StreamListener(Stream& s)
 {
 	pStream = &s;
-    strBuff = new String();
-	strBuff->reserve(201);
+	bufferSize = STREAM_LISTENER_BUFFER_SIZE;
+	buffer = new char[bufferSize];
+	ownBuffer = true;
+	init();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-bool StreamListener::hasCommand()
+StreamListener::StreamListener(Stream& s, char* lineBuffer, uint16_t lineBufferSize)
 {
-  if(!(pStream && pStream->available()))
-    return false;
-
-    char ch;
-    while(pStream->available())
-    {
-      ch = (char) pStream->read();
-
-      if(ch == '\r')
-        continue;
-            
-      if(ch == '\n')
-      {
-        return strBuff->length() > 0; // вдруг лишние управляющие символы придут в начале строки?
-      } // if
-
-      *strBuff += ch;
-      // не даём вычитать больше символов, чем надо - иначе нас можно заспамить
-      if(strBuff->length() >= 200)
-      {
-         clearCommand();
-         return false;
-      } // if
-    } // while
-
-    return false;
+	pStream = &s;
+	bufferSize = lineBufferSize;
+	buffer = lineBuffer;
+	ownBuffer = false;
+	init();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-CommandParser::CommandParser()
+StreamListener::~StreamListener()
+{
+	if(ownBuffer)
+		delete [] buffer;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void StreamListener::init()
+{
+	readPos = writePos = itemStart = itemEnd = 0;
+	hasLine = false;
+	binaryItem = false;
+	state = ListenerState::LineStart;
+	bytesLeft = 0;
+	lastByteAt = 0;
+	overflows = 0;
+	binaryErrors = 0;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool StreamListener::findLine()
+{
+	// целиком приняты все команды до начала той, что принимается сейчас
+	uint16_t complete = writePos;
+	if(state == ListenerState::Text || state == ListenerState::BinaryLength || state == ListenerState::BinaryBody)
+		complete = itemStart;
+
+	while(readPos < complete)
+	{
+		if(uint8_t(buffer[readPos]) == BINARY_COMMAND_SYNC)
+		{
+			// двоичный кадр: синхробайт, длина, нагрузка, CRC
+			uint16_t length;
+			memcpy(&length,buffer + readPos + 1,sizeof(length));
+			uint16_t frameEnd = readPos + 1 + sizeof(length) + length + 1;
+
+			if(crc8((const uint8_t*) buffer + readPos + 1,frameEnd - readPos - 2) != uint8_t(buffer[frameEnd-1]))
+			{
+				binaryErrors++;
+				readPos = frameEnd;
+				continue;
+			}
+
+			itemEnd = frameEnd;
+			binaryItem = true;
+			hasLine = true;
+			return true;
+		}
+
+		// текстовая строка, в буфер она попадает только вместе с переводом строки
+		char* lineEnd = (char*) memchr(buffer + readPos,'\n',complete - readPos);
+		if(!lineEnd)
+			break;
+
+		*lineEnd = 0; // строка команды - прямо в буфере
+		itemEnd = (lineEnd - buffer) + 1;
+		binaryItem = false;
+		hasLine = true;
+		return true;
+	}
+
+	if(readPos >= writePos)
+		readPos = writePos = itemStart = 0; // буфер пуст - начинаем с начала
+
+	return false;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void StreamListener::receive(uint8_t ch)
+{
+	switch(state)
+	{
+		case ListenerState::LineStart:
+		{
+			if(ch == '\r' || ch == '\n')
+				return; // пустые строки (лишние управляющие символы) пропускаем
+
+			itemStart = writePos;
+			buffer[writePos++] = ch;
+
+			if(ch == BINARY_COMMAND_SYNC)
+			{
+				state = ListenerState::BinaryLength;
+				bytesLeft = sizeof(uint16_t);
+				lastByteAt = uptime();
+			}
+			else
+				state = ListenerState::Text;
+		}
+		break;
+
+		case ListenerState::Text:
+		{
+			if(ch == '\r')
+				return;
+
+			buffer[writePos++] = ch;
+
+			if(ch == '\n')
+				state = ListenerState::LineStart;
+		}
+		break;
+
+		case ListenerState::BinaryLength:
+		{
+			buffer[writePos++] = ch;
+			lastByteAt = uptime();
+
+			if(--bytesLeft)
+				return;
+
+			uint16_t length;
+			memcpy(&length,buffer + itemStart + 1,sizeof(length));
+			bytesLeft = length + 1; // нагрузка и CRC
+			state = ListenerState::BinaryBody;
+
+			if(1 + sizeof(length) + uint32_t(length) + 1 > bufferSize)
+			{
+				// кадр не влезет в буфер целиком - выбрасываем его, не дожидаясь переполнения.
+				// При length == 0xFFFF bytesLeft переполняется в 0, и пропуск как раз закончится через 65536 байт
+				overflows++;
+				writePos = itemStart;
+				state = ListenerState::BinarySkip;
+			}
+		}
+		break;
+
+		case ListenerState::BinaryBody:
+		{
+			buffer[writePos++] = ch;
+			lastByteAt = uptime();
+
+			if(!--bytesLeft)
+				state = ListenerState::LineStart;
+		}
+		break;
+
+		case ListenerState::TextSkip:
+		{
+			if(ch == '\n')
+				state = ListenerState::LineStart;
+		}
+		break;
+
+		case ListenerState::BinarySkip:
+		{
+			lastByteAt = uptime();
+
+			if(!--bytesLeft)
+				state = ListenerState::LineStart;
+		}
+		break;
+	}
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool StreamListener::hasCommand()
 {
-  
+	if(hasLine)
+		return true;
+
+	if(findLine())
+		return true;
+
+	if(!pStream)
+		return false;
+
+	bool binaryState = state == ListenerState::BinaryLength || state == ListenerState::BinaryBody || state == ListenerState::BinarySkip;
+	if(binaryState && uptime() - lastByteAt > BINARY_COMMAND_TIMEOUT)
+	{
+		// двоичный кадр оборвался на середине (или длина в нём битая) - выбрасываем недопринятое, иначе следующая команда склеится с обрывком
+		if(state != ListenerState::BinarySkip)
+		{
+			binaryErrors++;
+			writePos = itemStart;
+		}
+		state = ListenerState::LineStart;
+	}
+
+	while(pStream->available())
+	{
+		if(writePos >= bufferSize && findLine())
+			return true; // буфер полон, но в нём есть целая команда - остальное подождёт в потоке
+
+		if(writePos >= bufferSize)
+		{
+			if(readPos)
+			{
+				// сдвигаем недочитанный хвост в начало буфера
+				memmove(buffer,buffer + readPos,writePos - readPos);
+				writePos -= readPos;
+				itemStart -= readPos;
+				readPos = 0;
+			}
+			else
+			{
+				// строка не влезает в буфер - выбрасываем её целиком, иначе нас можно заспамить
+				overflows++;
+				writePos = 0;
+				state = state == ListenerState::BinaryBody ? ListenerState::BinarySkip : ListenerState::TextSkip;
+			}
+		}
+
+		receive((uint8_t) pStream->read());
+	} // while
+
+	return findLine();
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-CommandParser::~CommandParser()
+const uint8_t* StreamListener::getBinaryCommand(uint16_t& length)
 {
-  clear();
+	memcpy(&length,buffer + readPos + 1,sizeof(length));
+	return (const uint8_t*) buffer + readPos + 1 + sizeof(length);
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-void CommandParser::clear()
+void StreamListener::clearCommand()
 {
-  for(size_t i=0;i<arguments.size();i++)
-  {
-    delete [] arguments[i];  
-  }
+	if(!hasLine)
+		return;
+
+	hasLine = false;
+	binaryItem = false;
+	readPos = itemEnd;
 
-  arguments.empty();
+	if(readPos >= writePos)
+		readPos = writePos = itemStart = 0; // буфер пуст - начинаем с начала
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+CommandParser::CommandParser()
+{
+	count = 0;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
 const char* CommandParser::getArg(size_t idx) const
 {
-  if(arguments.size() && idx < arguments.size())
-    return arguments[idx];
+	if(idx < count)
+		return arguments[idx];
 
-  return NULL;
+	return NULL;
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
-bool CommandParser::parse(const String& command, bool isSetCommand)
+bool CommandParser::parse(char* command, bool isSetCommand)
 {
-  clear();
-    // разбиваем на аргументы
-    const char* startPtr = command.c_str() + strlen_P(isSetCommand ? (const char* )CORE_COMMAND_SET : (const char*) CORE_COMMAND_GET);
-    size_t len = 0;
-
-    while(*startPtr)
-    {
-      const char* delimPtr = strchr(startPtr,CORE_COMMAND_PARAM_DELIMITER);
-            
-      if(!delimPtr)
-      {
-        len = strlen(startPtr);
-        char* newArg = new char[len + 1];
-        memset(newArg,0,len+1);
-        strncpy(newArg,startPtr,len);
-        arguments.push_back(newArg);        
-
-        return arguments.size();
-      } // if(!delimPtr)
-
-      size_t len = delimPtr - startPtr;
-
-     
-      char* newArg = new char[len + 1];
-      memset(newArg,0,len+1);
-      strncpy(newArg,startPtr,len);
-      arguments.push_back(newArg);
-
-      startPtr = delimPtr + 1;
-      
-    } // while      
-
-  return arguments.size();
-    
+	clear();
+		// разбиваем на аргументы, строка команды при этом портится - разделители заменяются на нули
+		char* startPtr = command + strlen_P(isSetCommand ? (const char* )CORE_COMMAND_SET : (const char*) CORE_COMMAND_GET);
+
+		while(*startPtr)
+		{
+			if(count >= COMMAND_PARSER_MAX_ARGS)
+			{
+				// аргументов больше, чем мы можем запомнить - такую команду не выполняем
+				clear();
+				return false;
+			}
+
+			arguments[count++] = startPtr;
+
+			char* delimPtr = strchr(startPtr,CORE_COMMAND_PARAM_DELIMITER);
+						
+			if(!delimPtr)
+				break;
+
+			*delimPtr = 0;
+			startPtr = delimPtr + 1;
+			
+		} // while      
+
+	return count;
+		
 }
 //--------------------------------------------------------------------------------------------------------------------------------------
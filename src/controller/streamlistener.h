@@ -5,36 +5,75 @@
 #include "../config.h"
 #include <stddef.h>
 //--------------------------------------------------------------------------------------------------------------------------------------
-// класс для накопления команды из потока
+// состояния приёма потока в StreamListener
+//--------------------------------------------------------------------------------------------------------------------------------------
+enum class ListenerState
+{
+  LineStart, // ждём начала строки или двоичного кадра
+  Text, // принимаем текстовую строку
+  BinaryLength, // принимаем длину двоичного кадра
+  BinaryBody, // принимаем нагрузку и CRC двоичного кадра
+  TextSkip, // строка не влезла в буфер, пропускаем её до перевода строки
+  BinarySkip // кадр не влезет в буфер, пропускаем его байты
+};
+//--------------------------------------------------------------------------------------------------------------------------------------
+// класс для накопления команды из потока: строки копятся в буфере фиксированного размера, без выделений памяти на каждый символ
+// и каждую команду. За один вызов hasCommand() из потока забирается всё, что влезает в буфер, т.е. пачка команд целиком.
+// Если в начале строки приходит BINARY_COMMAND_SYNC - дальше идёт кадр двоичного протокола (см. binaryprotocol.h), а не текст
 //--------------------------------------------------------------------------------------------------------------------------------------
 class StreamListener
 {
 private:
   Stream* pStream;
-  String* strBuff;
+  char* buffer;
+  uint16_t bufferSize;
+  bool ownBuffer;
+  uint16_t readPos; // начало текущей команды в буфере
+  uint16_t writePos; // куда пишется следующий байт
+  uint16_t itemStart; // начало принимаемой сейчас строки или кадра
+  uint16_t itemEnd; // начало следующей команды, если текущая принята целиком
+  bool hasLine;
+  bool binaryItem; // текущая команда - двоичный кадр
+  ListenerState state;
+  uint16_t bytesLeft; // сколько байт кадра осталось принять или пропустить
+  uint32_t lastByteAt; // когда пришёл последний байт двоичного кадра
+  uint32_t overflows;
+  uint32_t binaryErrors;
+
+  void init();
+  bool findLine();
+  void receive(uint8_t ch);
+
 public:
-  StreamListener(Stream& s);
+  StreamListener(Stream& s); // буфер на STREAM_LISTENER_BUFFER_SIZE символов выделяется один раз
+  StreamListener(Stream& s, char* lineBuffer, uint16_t lineBufferSize); // буфер - на стороне вызывающего
+  ~StreamListener();
 
   bool hasCommand();
-  const String& getCommand() {return *strBuff;}
-  void clearCommand() {delete strBuff; strBuff = new String(); }
+  bool isBinaryCommand() {return binaryItem;} // текущая команда - двоичный кадр, а не строка
+  char* getCommand() {return buffer + readPos;} // строка команды в буфере, действительна до clearCommand()
+  const uint8_t* getBinaryCommand(uint16_t& length); // нагрузка двоичного кадра (уже проверенная по CRC), действительна до clearCommand()
+  void clearCommand();
   Stream* getStream() {return pStream;}
+  uint32_t getOverflows() {return overflows;} // сколько строк и кадров выброшено, потому что не влезли в буфер
+  uint32_t getBinaryErrors() {return binaryErrors;} // сколько двоичных кадров выброшено из-за ошибки CRC или обрыва на середине
 
 };
 //--------------------------------------------------------------------------------------------------------------------------------------
-typedef Vector<char*> CommandArgsVec;
+// разбор команды на аргументы прямо в строке команды: разделители затираются нулями, в парсере остаются только указатели
+// на начала аргументов, без выделения памяти
 //--------------------------------------------------------------------------------------------------------------------------------------
 class CommandParser
 {
   private:
-    CommandArgsVec arguments;
+    char* arguments[COMMAND_PARSER_MAX_ARGS];
+    size_t count;
   public:
     CommandParser();
-    ~CommandParser();
 
-    void clear();
-    bool parse(const String& command, bool isSetCommand);
+    void clear() {count = 0;}
+    bool parse(char* command, bool isSetCommand);
     const char* getArg(size_t idx) const;
-    size_t argsCount() const {return arguments.size();}
+    size_t argsCount() const {return count;}
 };
 //--------------------------------------------------------------------------------------------------------------------------------------
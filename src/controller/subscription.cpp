@@ -0,0 +1,150 @@
+#include "subscription.h"
+#include "../utils/uptime.h"
+//--------------------------------------------------------------------------------------------------------------------------------------
+// Subscription
+//--------------------------------------------------------------------------------------------------------------------------------------
+Subscription::Subscription(Stream* s, SlotCache& cache, uint16_t minInterval, bool binary, uint8_t batchNumber)
+{
+	stream = s;
+	slotCache = &cache;
+	interval = minInterval;
+	binaryMode = binary;
+	batch = batchNumber;
+	nextSlot = 0;
+	coalesced = dropped = 0;
+	flowControl = false; // выясняется перед каждой записью, см. canWrite()
+
+	memset(pending,0,sizeof(pending));
+	memset(sent,0,sizeof(sent));
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool Subscription::wants(uint16_t slotID)
+{
+	if(!filter.size())
+		return true;
+
+	for(size_t i=0;i<filter.size();i++)
+	{
+		if(filter[i] == slotID)
+			return true;
+	}
+
+	return false;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void Subscription::push(uint8_t idx)
+{
+	if(!wants(slotCache->getSlotID(idx)))
+		return;
+
+	if(getBit(pending,idx))
+		coalesced++;
+
+	setBit(pending,idx,true);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void Subscription::forget(uint8_t idx)
+{
+	if(getBit(pending,idx))
+		dropped++;
+
+	// первое значение нового слота уйдёт без задержки
+	setBit(pending,idx,false);
+	setBit(sent,idx,false);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+void Subscription::update()
+{
+	uint32_t now = uptime();
+	uint8_t cnt = slotCache->size();
+
+	for(uint8_t i=0;i<cnt;i++)
+	{
+		uint8_t idx = (nextSlot + i) % cnt;
+
+		if(!getBit(pending,idx) || (getBit(sent,idx) && now - sentAt[idx] < interval))
+			continue;
+
+		if(!write(idx))
+		{
+			// поток забит - продолжим с этой же записи, когда освободится, а пока значения будут копиться в кэше
+			nextSlot = idx;
+			return;
+		}
+
+		setBit(pending,idx,false);
+		setBit(sent,idx,true);
+		sentAt[idx] = now;
+	}
+
+	if(cnt)
+		nextSlot = (nextSlot + 1) % cnt;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool Subscription::canWrite(uint16_t length)
+{
+	// Print::availableForWrite() по умолчанию возвращает 0, т.е. "не знаю" - такие потоки считаем всегда свободными.
+	// Но 0 возвращает и HardwareSerial с забитым буфером отправки (например, сразу после ответа на SUBSCRIBE),
+	// поэтому проверяем перед каждой записью: если поток хоть раз сообщил о свободном месте - верим ему и дальше
+	int room = stream->availableForWrite();
+
+	if(room > 0)
+		flowControl = true;
+
+	return !flowControl || room >= int(length);
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
+bool Subscription::write(uint8_t idx)
+{
+	uint8_t moduleID = slotCache->getModuleID(idx);
+	uint16_t slotID = slotCache->getSlotID(idx);
+	uint16_t dataType = slotCache->getDataType(idx);
+	uint8_t flags = slotCache->getFlags(idx);
+	uint16_t dataLength = slotCache->getDataLength(idx);
+	const uint8_t* data = slotCache->getData(idx);
+
+	if(binaryMode)
+	{
+		// ID модуля (1 байт), ID слота (2 байта), тип данных (2 байта), флаги (1 байт), длина данных (2 байта), данные
+		uint16_t frameDataLength = sizeof(moduleID) + sizeof(slotID) + sizeof(dataType) + sizeof(flags) + sizeof(dataLength) + dataLength;
+
+		// синхробайт, длина, номер пачки, команда, результат, данные, CRC
+		if(!canWrite(1 + 2 + 3 + frameDataLength + 1))
+			return false;
+
+		BinaryFrameWriter writer(*stream);
+		writer.begin(batch,BinaryCommand::SlotData,BinaryStatus::OK,frameDataLength);
+		writer.write(moduleID);
+		writer.write(slotID);
+		writer.write(dataType);
+		writer.write(flags);
+		writer.write(dataLength);
+		writer.write(data,dataLength);
+		writer.end();
+
+		return true;
+	}
+
+	// OK=SLOT|moduleID|slotID|dataType|flags|hexData: числа - не длиннее 5 символов, данные - по два символа на байт
+	if(!canWrite(8 + 5*5 + 2*dataLength + 2))
+		return false;
+
+	*stream << CORE_COMMAND_ANSWER_OK << F("SLOT") << CORE_COMMAND_PARAM_DELIMITER << moduleID
+		<< CORE_COMMAND_PARAM_DELIMITER << slotID
+		<< CORE_COMMAND_PARAM_DELIMITER << dataType
+		<< CORE_COMMAND_PARAM_DELIMITER << flags
+		<< CORE_COMMAND_PARAM_DELIMITER;
+
+	for(uint16_t i=0;i<dataLength;i++)
+	{
+		if(data[i] < 0x10)
+			*stream << '0';
+
+		stream->print(data[i],HEX);
+	}
+
+	*stream << ENDLINE;
+
+	return true;
+}
+//--------------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Arduino.h>
+#include "../utils/vector.h"
+#include "../config.h"
+#include "../message/message.h"
+#include "binaryprotocol.h"
+#include "slotcache.h"
+#include <stddef.h>
+//--------------------------------------------------------------------------------------------------------------------------------------
+// подписка потока консоли на изменения данных слотов.
+// Пришедшее значение не пишется в поток сразу: подписка лишь помечает запись кэша слотов как ждущую отправки,
+// а само значение берётся из кэша в момент записи в поток. Поэтому, пока поток забит или не вышел
+// минимальный интервал между отправками слота, новые значения того же слота просто затирают старое в кэше,
+// и подписчик получает только самое свежее.
+//--------------------------------------------------------------------------------------------------------------------------------------
+class Subscription
+{
+	public:
+		// minInterval - не чаще, чем раз во столько миллисекунд, отсылаются данные одного слота;
+		// binary - данные уходят кадрами двоичного протокола (BinaryCommand::SlotData) с номером пачки batch, иначе - строками OK=SLOT|...
+		Subscription(Stream* s, SlotCache& cache, uint16_t minInterval, bool binary, uint8_t batch);
+
+		Stream* getStream() { return stream; }
+		uint16_t getInterval() { return interval; }
+		bool isBinary() { return binaryMode; }
+
+		// фильтр по ID слотов, пустой фильтр - подписка на все слоты
+		void addFilter(uint16_t slotID) { filter.push_back(slotID); }
+		uint8_t getFilterSize() { return filter.size(); }
+		bool wants(uint16_t slotID);
+
+		// в записи кэша idx - новые данные слота
+		void push(uint8_t idx);
+
+		// запись кэша idx отдана другому слоту - всё, что о ней помнили, относится к старому слоту
+		void forget(uint8_t idx);
+
+		// отсылает в поток накопившиеся значения, пока поток их принимает
+		void update();
+
+		uint32_t getCoalesced() { return coalesced; } // сколько значений затёрто более свежими, не дойдя до подписчика
+		uint32_t getDropped() { return dropped; } // сколько значений потеряно, потому что их запись в кэше отдана другому слоту
+
+	private:
+
+		Stream* stream;
+		SlotCache* slotCache;
+		uint16_t interval;
+		bool binaryMode;
+		uint8_t batch;
+		bool flowControl; // поток хоть раз сообщил, сколько в него можно записать без ожидания
+
+		Vector<uint16_t> filter;
+
+		// по записям кэша слотов: ждёт отправки, уже отсылалась, когда отсылалась последний раз
+		uint8_t pending[(SLOT_CACHE_SIZE + 7)/8];
+		uint8_t sent[(SLOT_CACHE_SIZE + 7)/8];
+		uint32_t sentAt[SLOT_CACHE_SIZE];
+		uint8_t nextSlot; // с какой записи начинать следующий проход отправки - чтобы частый слот не забивал остальные
+
+		uint32_t coalesced, dropped;
+
+		static bool getBit(const uint8_t* bits, uint8_t idx) { return bits[idx/8] & (1 << (idx%8)); }
+		static void setBit(uint8_t* bits, uint8_t idx, bool val) { if(val) bits[idx/8] |= (1 << (idx%8)); else bits[idx/8] &= ~(1 << (idx%8)); }
+
+		bool canWrite(uint16_t length);
+		bool write(uint8_t idx);
+
+		Subscription(const Subscription& rhs);
+		Subscription& operator=(const Subscription& rhs);
+};
+//--------------------------------------------------------------------------------------------------------------------------------------
+typedef Vector<Subscription*> SubscriptionsList;
+//--------------------------------------------------------------------------------------------------------------------------------------
@@ -4,7 +4,7 @@
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 AnyData::AnyData(DataType _type, uint16_t _id)
 {
-	type = type;
+	type = _type;
 	id = _id;
 	
 	uint16_t dlen = getDataLength();
@@ -87,12 +87,20 @@ void AnyData::set(uint32_t w)
 	if(type != DataType::DWord)
 		return;
 	
+	if(flags.hasData && !memcmp(data,&w,sizeof(w))) // ничего не изменилось
+		return;
+	
+	flags.hasData = true;
+	
 	uint8_t* p = (uint8_t*)&w;
 	
 	data[0] = *p++;
 	data[1] = *p++;
 	data[2] = *p++;
 	data[3] = *p;
+	
+	trigger(true);
+	propagateChanges();
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 uint16_t AnyData::asWord()
@@ -115,10 +123,18 @@ void AnyData::set(uint16_t w)
 	if(type != DataType::Word)
 		return;
 	
+	if(flags.hasData && !memcmp(data,&w,sizeof(w))) // ничего не изменилось
+		return;
+	
+	flags.hasData = true;
+	
 	uint8_t* p = (uint8_t*)&w;
 	
 	data[0] = *p++;
 	data[1] = *p;
+	
+	trigger(true);
+	propagateChanges();
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 uint8_t AnyData::asByte()
@@ -134,9 +150,10 @@ void AnyData::set(uint8_t b)
 	if(!(type == DataType::Byte) )
 		return;
 	
-	if(data[0] == b) // ничего не изменилось
+	if(flags.hasData && data[0] == b) // ничего не изменилось
 		return;
 	
+	flags.hasData = true;
 	data[0] = b;
 	trigger(true);
 	propagateChanges();
@@ -165,7 +182,7 @@ void AnyData::set(Temperature& t)
 	
 	Temperature old = asTemperature();
 	
-	if(old == t) // ничего не поменялось, не надо отсылать в сеть
+	if(flags.hasData && old == t) // ничего не поменялось, не надо отсылать в сеть
 		return;
 	
 	flags.hasData = true;
@@ -210,9 +227,9 @@ void AnyData::setRaw(DataType rawType, const uint8_t* rawData, uint16_t rawDataS
 		return;
 	}
 	
-	flags.hasData = true;
+	bool hasChanges = !flags.hasData || memcmp(data,rawData,dlen);
 	
-	bool hasChanges = !memcmp(data,rawData,dlen);
+	flags.hasData = true;
 	
 	memcpy(data,rawData,dlen);
 	
@@ -223,5 +240,79 @@ void AnyData::setRaw(DataType rawType, const uint8_t* rawData, uint16_t rawDataS
 	
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool AnyData::toNumber(DataType dataType, const uint8_t* rawData, uint16_t rawDataSize, int32_t& result)
+{
+	switch(dataType)
+	{
+		case DataType::Byte:
+		case DataType::Word:
+		case DataType::DWord:
+		case DataType::Luminosity:
+		{
+			uint32_t val = 0;
+			if(rawDataSize > sizeof(val))
+				return false;
+			
+			memcpy(&val,rawData,rawDataSize);
+			result = val;
+		}
+		return true;
+		
+		case DataType::Temperature:
+		case DataType::SoilMoisture:
+		case DataType::Humidity:
+		{
+			// влажность - это пара "температура, влажность", нам нужна вторая половина
+			uint8_t offset = dataType == DataType::Humidity ? sizeof(Temperature) : 0;
+			if(rawDataSize < offset + sizeof(Temperature))
+				return false;
+			
+			Temperature t;
+			memcpy(&t,rawData + offset,sizeof(t));
+			
+			result = int32_t(t.Value)*100;
+			if(result < 0)
+				result -= t.Decimal;
+			else
+				result += t.Decimal;
+		}
+		return true;
+	}
+	
+	return false;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint16_t AnyData::fromNumber(DataType dataType, int32_t value, uint8_t* dest)
+{
+	switch(dataType)
+	{
+		case DataType::Byte:
+		case DataType::Word:
+		case DataType::DWord:
+		case DataType::Luminosity:
+		{
+			uint16_t len = dataType == DataType::Byte ? 1 : (dataType == DataType::Word ? 2 : 4);
+			uint32_t val = value;
+			memcpy(dest,&val,len);
+			return len;
+		}
+		
+		case DataType::Temperature:
+		case DataType::SoilMoisture:
+		{
+			Temperature t;
+			t.Value = value/100;
+			t.Decimal = value < 0 ? -(value%100) : value%100;
+			memcpy(dest,&t,sizeof(t));
+			return sizeof(t);
+		}
+		
+		default:
+		break;
+	}
+	
+	return 0; // влажность из одного числа не собрать - в ней ещё и температура
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -138,6 +138,12 @@ class AnyData
 		
 		bool triggered();
 		
+		// перевод данных слота в целое число и обратно: температура, влажность и влажность почвы - в сотых долях,
+		// для влажности (температура+влажность) берётся влажность; остальные типы - как есть, без знака.
+		// toNumber возвращает false, если тип данных не поддерживается, fromNumber - длину записанных данных, 0 - тип не поддерживается
+		static bool toNumber(DataType dataType, const uint8_t* rawData, uint16_t rawDataSize, int32_t& result);
+		static uint16_t fromNumber(DataType dataType, int32_t value, uint8_t* dest);
+		
 		bool operator==(const AnyData& rhs)
 		{
 			return (this->id == rhs.id);
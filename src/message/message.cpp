@@ -2,13 +2,16 @@
 #include "message.h"
 #include "../config.h"
 #include "../data/anydata.h"
+#include "../utils/allocations.h"
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 extern "C" {
 static void __nohandler_b(bool b){}
+static void __nohandler_u8(uint8_t u){}
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void registration(bool result) __attribute__ ((weak, alias("__nohandler_b")));
  void scanning(bool begin) __attribute__ ((weak, alias("__nohandler_b")));
+void configuration(uint8_t slotNumber) __attribute__ ((weak, alias("__nohandler_u8")));
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 Message::Message()
 {
@@ -34,7 +37,7 @@ Message::Message(const Message& rhs)
 {
 	delete [] payload;
 	payloadLength = rhs.payloadLength;
-	payload = new uint8_t[payloadLength];
+	payload = allocateBuffer(payloadLength);
 	memcpy(payload,rhs.payload,payloadLength);
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -42,7 +45,7 @@ Message& Message::operator=(const Message& rhs)
 {
 	delete [] payload;
 	payloadLength = rhs.payloadLength;
-	payload = new uint8_t[payloadLength];
+	payload = allocateBuffer(payloadLength);
 	memcpy(payload,rhs.payload,payloadLength);
 	
 	return *this;
@@ -58,7 +61,7 @@ Message Message::parse(const uint8_t* rawData, uint16_t rawDataLength)
 	
 	// копируем сырое сообщение к себе
 	m.payloadLength = rawDataLength;	
-	m.payload = new uint8_t[m.payloadLength];
+	m.payload = allocateBuffer(m.payloadLength);
 	memcpy(m.payload,rawData,m.payloadLength);
 	
 	
@@ -128,7 +131,7 @@ Message Message::Scan(uint32_t controllerID, uint8_t moduleID)
 	
 	// конструируем сырое сообщение
 	m.payloadLength = MESSAGE_HEADER_SIZE;
-	m.payload = new uint8_t[m.payloadLength];
+	m.payload = allocateBuffer(m.payloadLength);
 	Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
 	
 	
@@ -155,7 +158,7 @@ Message Message::ScanResponse(uint32_t controllerID, uint8_t moduleID, const cha
 	// конструируем сырое сообщение
 	uint8_t nameLen = strlen(moduleName);
 	m.payloadLength = MESSAGE_HEADER_SIZE + nameLen + 3;
-	m.payload = new uint8_t[m.payloadLength];	
+	m.payload = allocateBuffer(m.payloadLength);	
 	uint8_t* writePtr = Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
 	
 	// пишем полезную нагрузку
@@ -170,6 +173,31 @@ Message Message::ScanResponse(uint32_t controllerID, uint8_t moduleID, const cha
 
 	memcpy(writePtr,&observeDataCount,sizeof(uint8_t));
 	
+	return m;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+Message Message::Ping(uint32_t controllerID, uint8_t moduleID)
+{
+	/*
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	сообщение "пинг"
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	
+		отсылается контроллером конкретному модулю для проверки связи, структура:
+
+		ID контроллера
+		ID модуля
+		Тип сообщения - "пинг"
+	*/
+	
+	Message m(controllerID,moduleID,Messages::Ping);
+	
+	// конструируем сырое сообщение
+	m.payloadLength = MESSAGE_HEADER_SIZE;
+	m.payload = allocateBuffer(m.payloadLength);
+	Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
+	
+	
 	return m;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -191,7 +219,7 @@ Message Message::Pong(uint32_t controllerID, uint8_t moduleID)
 	
 	// конструируем сырое сообщение
 	m.payloadLength = MESSAGE_HEADER_SIZE;
-	m.payload = new uint8_t[m.payloadLength];
+	m.payload = allocateBuffer(m.payloadLength);
 	Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
 	
 	
@@ -216,10 +244,79 @@ Message Message::RegistrationResult(uint32_t controllerID, uint8_t moduleID)
 	
 	// конструируем сырое сообщение
 	m.payloadLength = MESSAGE_HEADER_SIZE;
-	m.payload = new uint8_t[m.payloadLength];
+	m.payload = allocateBuffer(m.payloadLength);
 	Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
 	
 	
+	return m;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+Message Message::OnlineModulesList(uint32_t controllerID, uint8_t moduleID, const uint8_t* onlineMask)
+{
+	/*
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	сообщение "список онлайн-модулей" (OnlineModulesList)
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+		отсылается контроллером в ответ на событие "запрос модулей онлайн", или на широковещательный адрес при изменении списка модулей на связи, структура:
+
+			ID контроллера
+			ID модуля
+			Тип сообщения - "список онлайн-модулей" (OnlineModulesList)
+			нагрузка:			
+				- Битовая маска онлайн-модулей (32 байта)
+	*/
+
+	Message m(controllerID,moduleID,Messages::OnlineModulesList);
+
+	// конструируем сырое сообщение
+	m.payloadLength = MESSAGE_HEADER_SIZE + ONLINE_MODULES_MASK_SIZE;
+	m.payload = allocateBuffer(m.payloadLength);
+	uint8_t* writePtr = Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
+
+	memcpy(writePtr,onlineMask,ONLINE_MODULES_MASK_SIZE);
+
+	return m;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+Message Message::Beacon(uint32_t controllerID, uint16_t slotDuration, const uint8_t* moduleIDs, uint8_t modulesCount)
+{
+	/*
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	сообщение "маяк расписания" (Beacon)
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+		отсылается контроллером на широковещательный адрес в начале каждого кадра расписания доступа к шине, структура:
+
+			ID контроллера
+			ID модуля = 0xFF
+			Тип сообщения - "маяк расписания" (Beacon)
+			нагрузка:
+				- длительность одного слота расписания, миллисекунд (2 байта)
+				- кол-во модулей в расписании (1 байт)
+				- ID модулей в порядке следования их слотов (по 1 байту на модуль)
+
+		moduleIDs == NULL - место под ID модулей остаётся пустым, вызывающий пишет их прямо в сообщение, через get(3)
+	*/
+
+	Message m(controllerID,0xFF,Messages::Beacon);
+
+	// конструируем сырое сообщение
+	m.payloadLength = MESSAGE_HEADER_SIZE + 3 + modulesCount;
+	m.payload = allocateBuffer(m.payloadLength);
+	uint8_t* writePtr = Message::writeHeader(m.payload, controllerID, m.moduleID, static_cast<uint16_t>(m.type));
+
+	// пишем полезную нагрузку
+	memcpy(writePtr,&slotDuration,sizeof(uint16_t));
+	writePtr += sizeof(uint16_t);
+
+	*writePtr++ = modulesCount;
+
+	if(moduleIDs)
+		memcpy(writePtr,moduleIDs,modulesCount);
+	else
+		memset(writePtr,0,modulesCount);
+
 	return m;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -245,7 +342,7 @@ Message Message::BroadcastSlotRegister(uint32_t controllerID, uint8_t moduleID,
 	Message m(controllerID,moduleID,Messages::BroadcastSlotRegister);
 	
 	m.payloadLength = MESSAGE_HEADER_SIZE + 1;
-	m.payload = new uint8_t[m.payloadLength];
+	m.payload = allocateBuffer(m.payloadLength);
 	
 	uint8_t* writePtr = Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
 	
@@ -280,7 +377,7 @@ Message Message::BroadcastSlotData(uint32_t controllerID, uint8_t moduleID, AnyD
 	uint16_t dataLen = dt->getDataLength();
 	
 	m.payloadLength = MESSAGE_HEADER_SIZE + dataLen + 7;
-	m.payload = new uint8_t[m.payloadLength];
+	m.payload = allocateBuffer(m.payloadLength);
 	uint8_t* writePtr = Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
 	
 	// копируем нагрузку
@@ -327,7 +424,7 @@ Message Message::ObserveSlotRegister(uint32_t controllerID, uint8_t moduleID, ui
 	Message m(controllerID,moduleID,Messages::ObserveSlotRegister);
 	
 	m.payloadLength = MESSAGE_HEADER_SIZE + 1;
-	m.payload = new uint8_t[m.payloadLength];
+	m.payload = allocateBuffer(m.payloadLength);
 	
 	uint8_t* writePtr = Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
 	
@@ -356,7 +453,7 @@ Message Message::ObserveSlotData(uint32_t controllerID, uint8_t moduleID, uint16
 	Message m(controllerID,moduleID,Messages::ObserveSlotData);
 	
 	m.payloadLength = MESSAGE_HEADER_SIZE + 6;
-	m.payload = new uint8_t[m.payloadLength];
+	m.payload = allocateBuffer(m.payloadLength);
 	uint8_t* writePtr = Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
 	
 	
@@ -369,6 +466,81 @@ Message Message::ObserveSlotData(uint32_t controllerID, uint8_t moduleID, uint16
 	return m;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+Message Message::AnyDataBroadcast(uint32_t controllerID, uint8_t moduleID, uint16_t slotID, uint16_t dataType, const uint8_t* data, uint16_t dataLength)
+{
+	/*
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	сообщение "данные слота"
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	
+		отсылается контроллером в эфир для конкретного модуля или на широковещательный адрес, структура:
+		
+			ID контроллера
+			ID модуля
+			Тип сообщения - "данные слота"
+			нагрузка:
+				- ID слота (уникальный в рамках системы ID слота, 2 байта)
+				- тип данных слота (температура и т.п., 2 байта)
+				- флаги (наличие данных и пр., 1 байт)
+				- длина данных слота (2 байта)
+				- данные слота
+	
+	*/
+	
+	Message m(controllerID,moduleID,Messages::AnyDataBroadcast);
+	
+	// конструируем сырое сообщение
+	m.payloadLength = MESSAGE_HEADER_SIZE + dataLength + 7;
+	m.payload = allocateBuffer(m.payloadLength);
+	uint8_t* writePtr = Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
+	
+	// копируем нагрузку
+	memcpy(writePtr,&slotID,sizeof(uint16_t));
+	writePtr += sizeof(uint16_t);
+	
+	memcpy(writePtr,&dataType,sizeof(uint16_t));
+	writePtr += sizeof(uint16_t);
+
+	uint8_t helper8 = dataLength ? 1 : 0; // есть данные
+	memcpy(writePtr,&helper8,sizeof(uint8_t));
+	writePtr += sizeof(uint8_t);
+	
+	memcpy(writePtr,&dataLength,sizeof(uint16_t));
+	writePtr += sizeof(uint16_t);
+
+	memcpy(writePtr,data,dataLength);
+	
+	return m;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+Message Message::AnyDataRequest(uint32_t controllerID, uint8_t moduleID, uint16_t slotID)
+{
+	/*
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	сообщение "запрос данных слота" (AnyDataRequest)
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	
+		отсылается контроллером в эфир для конкретного модуля, для запроса с него данных зарегистрированного исходящего слота. Структура:	
+
+			ID контроллера
+			ID модуля
+			Тип сообщения - "запрос данных слота" (AnyDataRequest)
+			нагрузка:
+				- ID слота (уникальный в рамках системы ID слота, 2 байта)
+	*/
+	
+	Message m(controllerID,moduleID,Messages::AnyDataRequest);
+	
+	m.payloadLength = MESSAGE_HEADER_SIZE + sizeof(uint16_t);
+	m.payload = allocateBuffer(m.payloadLength);
+	
+	uint8_t* writePtr = Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
+	
+	memcpy(writePtr,&slotID,sizeof(uint16_t));
+	
+	return m;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 Message Message::AnyDataResponse(uint32_t controllerID, uint8_t moduleID, AnyData* dt)
 {
 	/*
@@ -396,7 +568,7 @@ Message Message::AnyDataResponse(uint32_t controllerID, uint8_t moduleID, AnyDat
 	uint16_t dataLen = dt->getDataLength();
 	
 	m.payloadLength = MESSAGE_HEADER_SIZE + dataLen + 7;
-	m.payload = new uint8_t[m.payloadLength];
+	m.payload = allocateBuffer(m.payloadLength);
 	uint8_t* writePtr = Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
 	
 	// копируем нагрузку
@@ -420,6 +592,30 @@ Message Message::AnyDataResponse(uint32_t controllerID, uint8_t moduleID, AnyDat
 	return m;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+Message Message::EventRequest(uint32_t controllerID, uint8_t moduleID)
+{
+	/*
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	сообщение "запрос события" (EventRequest)
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+		отсылается контроллером в эфир для конкретного модуля, с целью получения событий, которые хочет сообщить модуль, структура:
+		
+			ID контроллера
+			ID модуля
+			Тип сообщения - "запрос события" (EventRequest)
+	*/
+	
+	Message m(controllerID,moduleID,Messages::EventRequest);
+	
+	// конструируем сырое сообщение
+	m.payloadLength = MESSAGE_HEADER_SIZE;
+	m.payload = allocateBuffer(m.payloadLength);
+	Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
+	
+	return m;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 Message Message::EventResponse(uint32_t controllerID, uint8_t moduleID, uint8_t hasEvent, Event* e)
 {
 /*
@@ -451,7 +647,7 @@ Message Message::EventResponse(uint32_t controllerID, uint8_t moduleID, uint8_t
 	}
 	
 	m.payloadLength = dataLen;
-	m.payload = new uint8_t[m.payloadLength];
+	m.payload = allocateBuffer(m.payloadLength);
 	uint8_t* writePtr = Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
 	
 	// копируем нагрузку
@@ -475,6 +671,206 @@ Message Message::EventResponse(uint32_t controllerID, uint8_t moduleID, uint8_t
 	return m;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+Message Message::ConfigurationRequest(uint32_t controllerID, uint8_t moduleID)
+{
+	/*
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	сообщение "запрос конфигурации" (ConfigurationRequest)
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	
+		отсылается контроллером на модуль, для запроса информации о его конфигурации, структура:
+		
+			ID контроллера
+			ID модуля
+			Тип сообщения - "запрос конфигурации" (ConfigurationRequest)
+	*/
+	
+	Message m(controllerID,moduleID,Messages::ConfigurationRequest);
+	
+	// конструируем сырое сообщение
+	m.payloadLength = MESSAGE_HEADER_SIZE;
+	m.payload = allocateBuffer(m.payloadLength);
+	Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
+	
+	return m;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+Message Message::ConfigurationResponse(uint32_t controllerID, uint8_t moduleID, uint8_t slotsCount)
+{
+	/*
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	сообщение "данные конфигурации" (ConfigurationResponse)
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+			
+		отсылается модулем в ответ на событие "запрос конфигурации" (ConfigurationRequest), структура:
+
+			ID контроллера
+			ID модуля
+			Тип сообщения - "данные конфигурации" (ConfigurationResponse)
+			нагрузка:			
+				- Кол-во слотов конфигурации (1 байт)
+	*/
+	
+	Message m(controllerID,moduleID,Messages::ConfigurationResponse);
+	
+	m.payloadLength = MESSAGE_HEADER_SIZE + 1;
+	m.payload = allocateBuffer(m.payloadLength);
+	
+	uint8_t* writePtr = Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
+	
+	*writePtr = slotsCount;
+	
+	return m;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+Message Message::ConfigurationSlotRequest(uint32_t controllerID, uint8_t moduleID, uint8_t slotNumber)
+{
+	/*
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	сообщение "запрос слота конфигурации" (ConfigurationSlotRequest)
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+		отсылается контроллером на модуль для запроса определённого слота конфигурации, структура:
+
+			ID контроллера
+			ID модуля
+			Тип сообщения - "запрос слота конфигурации" (ConfigurationSlotRequest)
+			нагрузка:			
+				- Номер слота конфигурации (1 байт)
+	*/
+	
+	Message m(controllerID,moduleID,Messages::ConfigurationSlotRequest);
+	
+	m.payloadLength = MESSAGE_HEADER_SIZE + 1;
+	m.payload = allocateBuffer(m.payloadLength);
+	
+	uint8_t* writePtr = Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
+	
+	*writePtr = slotNumber;
+	
+	return m;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+Message Message::ConfigurationSlotResponse(uint32_t controllerID, uint8_t moduleID, uint8_t slotNumber, ConfigSlotType slotType, const char* slotName, const uint8_t* data, uint16_t dataLength)
+{
+	/*
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	сообщение "данные слота конфигурации" (ConfigurationSlotResponse)
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+		
+		отсылается модулем в ответ на сообщение "запрос слота конфигурации" (ConfigurationSlotRequest), структура:
+		
+			ID контроллера
+			ID модуля
+			Тип сообщения - "данные слота конфигурации" (ConfigurationSlotResponse)
+			нагрузка:			
+				- Номер слота конфигурации (1 байт)
+				- Тип слота (строковые данные, список и т.п.) (2 байта)
+				- Длина имени слота (1 байт)
+				- Имя слота
+				- Длина данных слота (2 байта)
+				- Данные слота конфигурации
+	*/
+	
+	Message m(controllerID,moduleID,Messages::ConfigurationSlotResponse);
+	
+	// конструируем сырое сообщение
+	uint8_t nameLen = strlen(slotName);
+	
+	m.payloadLength = MESSAGE_HEADER_SIZE + 6 + nameLen + dataLength;
+	m.payload = allocateBuffer(m.payloadLength);
+	uint8_t* writePtr = Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
+	
+	// пишем полезную нагрузку
+	*writePtr++ = slotNumber;
+	
+	uint16_t helper16 = static_cast<uint16_t>(slotType);
+	memcpy(writePtr,&helper16,sizeof(uint16_t));
+	writePtr += sizeof(uint16_t);
+	
+	*writePtr++ = nameLen;
+	
+	memcpy(writePtr,slotName,nameLen);
+	writePtr += nameLen;
+	
+	memcpy(writePtr,&dataLength,sizeof(uint16_t));
+	writePtr += sizeof(uint16_t);
+	
+	memcpy(writePtr,data,dataLength);
+	
+	return m;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+Message Message::SaveConfigurationSlot(uint32_t controllerID, uint8_t moduleID, uint8_t slotNumber, const uint8_t* data, uint16_t dataLength)
+{
+	/*
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	сообщение "сохранить слот конфигурации" (SaveConfigurationSlot)
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	
+		отсылается контроллером на модуль для сохранения слота конфигурации, структура:
+
+			ID контроллера
+			ID модуля
+			Тип сообщения - "сохранить слот конфигурации" (SaveConfigurationSlot)
+			нагрузка:			
+				- Номер слота конфигурации (1 байт)
+				- Длина данных слота (2 байта)
+				- Данные слота конфигурации
+	*/
+	
+	Message m(controllerID,moduleID,Messages::SaveConfigurationSlot);
+	
+	m.payloadLength = MESSAGE_HEADER_SIZE + 3 + dataLength;
+	m.payload = allocateBuffer(m.payloadLength);
+	uint8_t* writePtr = Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
+	
+	*writePtr++ = slotNumber;
+	
+	memcpy(writePtr,&dataLength,sizeof(uint16_t));
+	writePtr += sizeof(uint16_t);
+	
+	memcpy(writePtr,data,dataLength);
+	
+	return m;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+Message Message::ConfigurationSlotSaved(uint32_t controllerID, uint8_t moduleID, uint8_t slotNumber, bool success, const char* answer)
+{
+	/*
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	сообщение "слот конфигурации сохранён" (ConfigurationSlotSaved)
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+				
+		отсылается модулем в ответ на сообщение "сохранить слот конфигурации" (SaveConfigurationSlot), структура:
+		
+			ID контроллера
+			ID модуля
+			Тип сообщения - "слот конфигурации сохранён" (ConfigurationSlotSaved)
+			нагрузка:			
+				- Номер слота конфигурации (1 байт)
+				- Флаг успешности сохранения (1 байт)
+				- Длина сообщения (1 байт)
+				- Сообщение
+	*/
+	
+	Message m(controllerID,moduleID,Messages::ConfigurationSlotSaved);
+	
+	uint8_t answerLen = strlen(answer);
+	
+	m.payloadLength = MESSAGE_HEADER_SIZE + 3 + answerLen;
+	m.payload = allocateBuffer(m.payloadLength);
+	uint8_t* writePtr = Message::writeHeader(m.payload, controllerID, moduleID, static_cast<uint16_t>(m.type));
+	
+	*writePtr++ = slotNumber;
+	*writePtr++ = success ? 1 : 0;
+	*writePtr++ = answerLen;
+	
+	memcpy(writePtr,answer,answerLen);
+	
+	return m;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // Event
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 Event::Event(Events _type)
@@ -487,7 +883,7 @@ Event::Event(Events _type)
 Event::Event(const Event& rhs)
 {
 	type = rhs.type;
-	data = new uint8_t[rhs.dataLength];
+	data = allocateBuffer(rhs.dataLength);
 	memcpy(data,rhs.data,rhs.dataLength);
 	dataLength = rhs.dataLength;
 }
@@ -497,7 +893,7 @@ Event& Event::operator=(const Event& rhs)
 	delete [] data;
 	
 	type = rhs.type;
-	data = new uint8_t[rhs.dataLength];
+	data = allocateBuffer(rhs.dataLength);
 	memcpy(data,rhs.data,rhs.dataLength);
 	dataLength = rhs.dataLength;
 	
@@ -525,10 +921,11 @@ Event* Event::SlotDataChanged(uint8_t moduleID, AnyData* data)
 				
 */	
 		
+	countAllocation();
 	Event* e = new Event(Events::SlotDataChanged);
 	
 	e->dataLength = 3;
-	e->data = new uint8_t[e->dataLength];
+	e->data = allocateBuffer(e->dataLength);
 	
 	uint8_t* ptr = e->data;
 	
@@ -144,7 +144,8 @@
 	сообщение "данные слота" (AnyDataBroadcast)
 	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
 	
-		отсылается контроллером в эфир для конкретного модуля, который зарегистрировал в контроллере свой входящий слот. Структура:
+		отсылается контроллером в эфир для конкретного модуля, который зарегистрировал в контроллере свой входящий слот,
+		или на широковещательный адрес - тогда данные слота забирают все модули, которые его наблюдают. Структура:
 		
 			ID контроллера
 			ID модуля
@@ -330,15 +331,34 @@
 	сообщение "список онлайн-модулей" (OnlineModulesList)
 	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
-		отсылается контроллером в ответ на событие "запрос модулей онлайн" (OnlineModulesNeeded), структура:
+		отсылается контроллером в ответ на событие "запрос модулей онлайн" (OnlineModulesNeeded), а также на широковещательный адрес
+		при каждом изменении списка модулей, которые на связи, структура:
 
 			ID контроллера
 			ID модуля
 			Тип сообщения - "список онлайн-модулей" (OnlineModulesList)
 			нагрузка:			
 				- Битовая маска онлайн-модулей (32 байта)
-		
-		
+
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	сообщение "маяк расписания" (Beacon)
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+		отсылается контроллером на широковещательный адрес в начале каждого кадра расписания доступа к шине (TDMA), структура:
+
+			ID контроллера
+			ID модуля = 0xFF
+			Тип сообщения - "маяк расписания" (Beacon)
+			нагрузка:
+				- длительность одного слота расписания, миллисекунд (2 байта)
+				- кол-во модулей в расписании (1 байт)
+				- ID модулей в порядке следования их слотов (по 1 байту на модуль)
+
+		кадр расписания начинается с приёма маяка и состоит из (кол-во модулей + 1) слотов одинаковой длительности. Нулевой слот принадлежит контроллеру,
+		модуль, стоящий в списке на позиции N, получает слот N+1. Модуль, получивший маяк, передаёт в эфир только в пределах своего слота,
+		таким образом ответы модулей на шине никогда не перекрываются.
+
+
 	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
 	СОБЫТИЯ
 	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -465,9 +485,11 @@
 extern "C" {
   void registration(bool result); // событие "регистрация завершена"
   void scanning(bool begin); // событие "сканирование"
+  void configuration(uint8_t slotNumber); // событие "слот конфигурации изменён"
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 #define MESSAGE_HEADER_SIZE (4+1+2) // размер заголовка любого сообщения (ID контроллера + ID модуля + тип сообщения)
+#define ONLINE_MODULES_MASK_SIZE 32 // размер битовой маски онлайн-модулей, байт (по биту на каждый из 256 адресов)
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 enum class Messages : uint16_t // сообщения
 {
@@ -495,6 +517,7 @@ enum class Messages : uint16_t // сообщения
 		RegistrationRequest, // сообщение "запрос регистрации"
 		RegistrationResult, // сообщение "регистрация завершена"
 		OnlineModulesList, // сообщение "список онлайн-модулей"
+		Beacon, // сообщение "маяк расписания"
 };
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 enum class Events : uint16_t // события
@@ -505,6 +528,14 @@ enum class Events : uint16_t // события
 //	ModuleLinkBroken, // событие "Пропала связь с модулем"
 };
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+enum class ConfigSlotType : uint16_t // типы слотов конфигурации
+{
+	Raw, // произвольные байты
+	String, // строка
+	Number, // целое со знаком (4 байта)
+	Flag, // флаг (1 байт)
+};
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 class AnyData; // forward declaration
 class Event; // forward declaration
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -565,15 +596,27 @@ class Message
 		// методы создания пакетов для различных типов сообщений
 		static Message Scan(uint32_t controllerID, uint8_t moduleID);
 		static Message ScanResponse(uint32_t controllerID, uint8_t moduleID, const char* moduleName, uint8_t broadcastDataCount,uint8_t observeDataCount);		
+		static Message Ping(uint32_t controllerID, uint8_t moduleID);
 		static Message Pong(uint32_t controllerID, uint8_t moduleID);
 		static Message BroadcastSlotRegister(uint32_t controllerID, uint8_t moduleID, uint8_t slotNumber);
 		static Message BroadcastSlotData(uint32_t controllerID, uint8_t moduleID, AnyData* data);
 		static Message ObserveSlotRegister(uint32_t controllerID, uint8_t moduleID, uint8_t slotNumber);
 		static Message ObserveSlotData(uint32_t controllerID, uint8_t moduleID, uint16_t slotID, uint32_t frequency);
+		static Message AnyDataRequest(uint32_t controllerID, uint8_t moduleID, uint16_t slotID);
 		static Message AnyDataResponse(uint32_t controllerID, uint8_t moduleID, AnyData* data);
+		static Message AnyDataBroadcast(uint32_t controllerID, uint8_t moduleID, uint16_t slotID, uint16_t dataType, const uint8_t* data, uint16_t dataLength);
+		static Message EventRequest(uint32_t controllerID, uint8_t moduleID);
 		static Message EventResponse(uint32_t controllerID, uint8_t moduleID, uint8_t hasEvent, Event* e);
 		static Message RegistrationResult(uint32_t controllerID, uint8_t moduleID);
-		
+		static Message OnlineModulesList(uint32_t controllerID, uint8_t moduleID, const uint8_t* onlineMask);
+		static Message Beacon(uint32_t controllerID, uint16_t slotDuration, const uint8_t* moduleIDs, uint8_t modulesCount);
+		static Message ConfigurationRequest(uint32_t controllerID, uint8_t moduleID);
+		static Message ConfigurationResponse(uint32_t controllerID, uint8_t moduleID, uint8_t slotsCount);
+		static Message ConfigurationSlotRequest(uint32_t controllerID, uint8_t moduleID, uint8_t slotNumber);
+		static Message ConfigurationSlotResponse(uint32_t controllerID, uint8_t moduleID, uint8_t slotNumber, ConfigSlotType slotType, const char* slotName, const uint8_t* data, uint16_t dataLength);
+		static Message SaveConfigurationSlot(uint32_t controllerID, uint8_t moduleID, uint8_t slotNumber, const uint8_t* data, uint16_t dataLength);
+		static Message ConfigurationSlotSaved(uint32_t controllerID, uint8_t moduleID, uint8_t slotNumber, bool success, const char* answer);
+
 		// конструкторы
 		Message();
 		Message(uint32_t controllerID, uint8_t moduleID, Messages type);
@@ -1,10 +1,12 @@
 #include "module.h"
 #include "../core.h"
+#include "../utils/profiler.h"
 #include <stddef.h>
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 SmartModule* _Module = NULL; // рабочий экземпляр модуля
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 SmartModule::SmartModule(const char* _moduleName, uint8_t _moduleID, Transport& t, _Storage& s)
+	: rules(*this)
 {
 	moduleName = _moduleName;
 	moduleID = _moduleID;
@@ -12,6 +14,18 @@ SmartModule::SmartModule(const char* _moduleName, uint8_t _moduleID, Transport&
 	transport = &t;
 	controllerID = 0xFFFFFFFF;
 	canWork = false;
+	inRegMode = false;
+	regTimeout = regStartedAt = 0;
+	oldControllerID = controllerID;
+	configEndAddress = CONFIG_STORAGE_ADDRESS;
+	configDirty = false;
+	configSavedAt = configDirtySince = 0;
+	configAcksFlushed = 0;
+	memset(onlineModules,0,sizeof(onlineModules));
+	inRules = false;
+	heardSlotsCount = nextHeardSlot = 0;
+	slotRefreshAt = 0;
+	nextRefreshSlot = 0;
 	
 	_Module = this;
 	
@@ -23,6 +37,8 @@ SmartModule::~SmartModule()
 	{
 		delete events[i];
 	}
+	
+	clearOutgoing();
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void SmartModule::linkToController(uint32_t _controllerID)
@@ -84,6 +100,8 @@ void SmartModule::update()
 	
 	inUpdate = true;
 	
+	PROFILE_SECTION(ProfileSection::ModuleUpdate);
+	
 	// проверяем - если мы в режиме регистрации и она слишком долго длится - выходим из неё
 	if(inRegMode && uptime() - regStartedAt >= regTimeout)
 	{
@@ -94,40 +112,60 @@ void SmartModule::update()
 		
 	}
 	
-	// для начала - сбрасываем флаг получения новых данных с контроллера у всех наблюдаемых слотов
-	for(size_t i=0;i<observeList.size();i++)
-	{
-		observeList[i].data->trigger(false);
-	}
-	
-	// теперь, если мы получим новые данные для слота - то проверка на isTriggered() для этого слота
-	// будет срабатывать до следующего вызова update()
-	
-	// далее - нам надо проверить, не протухли ли у нас какие-либо данные в списке наблюдаемых слотов?
-	uint32_t now = uptime();
-	for(size_t i=0;i<observeList.size();i++)
 	{
-		if( (now - observeList[i].lastDataAt) >= observeList[i].timeout)
+		PROFILE_SECTION(ProfileSection::ModuleObserveSlots);
+		
+		// для начала - сбрасываем флаг получения новых данных с контроллера у всех наблюдаемых слотов
+		for(size_t i=0;i<observeList.size();i++)
+		{
+			observeList[i].data->trigger(false);
+		}
+		
+		// теперь, если мы получим новые данные для слота - то проверка на isTriggered() для этого слота
+		// будет срабатывать до следующего вызова update()
+		
+		// далее - нам надо проверить, не протухли ли у нас какие-либо данные в списке наблюдаемых слотов?
+		uint32_t now = uptime();
+		for(size_t i=0;i<observeList.size();i++)
 		{
-			DBG(F("[TIMEOUT] reset slot #"));
-			DBGLN(observeList[i].data->getID());
+			if( (now - observeList[i].lastDataAt) >= observeList[i].timeout)
+			{
+				DBG(F("[TIMEOUT] reset slot #"));
+				DBGLN(observeList[i].data->getID());
 
-			// данные протухли, надо сбросить показания датчика, триггер взведётся автоматически
-			observeList[i].data->reset();
-			observeList[i].lastDataAt = now; // обновляем таймер
+				// данные протухли, надо сбросить показания датчика, триггер взведётся автоматически
+				observeList[i].data->reset();
+				observeList[i].lastDataAt = now; // обновляем таймер
+			}
 		}
+		
+		// услышанные значения чужих слотов для правил тоже протухают
+		expireHeardSlots();
 	}
 	
-	// обновляем транспорт
-	transport->update();
+	{
+		// обновляем транспорт
+		PROFILE_SECTION(ProfileSection::ModuleTransport);
+		transport->update();
+	}
+	
+	// фоновая работа хранилища (например, отложенная запись)
+	storage->update();
+	updateConfigFlush();
 	
 	// проверяем, принял ли транспорт какой-нибудь пакет?
 	if(transport->available())
 	{
+		PROFILE_SECTION(ProfileSection::ModuleIncoming);
 		processIncomingMessage(); // обрабатываем входящее сообщение
 	}
 	
-	// все входящие сообщения обработаны
+	{
+		// все входящие сообщения обработаны, отсылаем то, что ждёт своего слота в расписании
+		PROFILE_SECTION(ProfileSection::ModuleOutgoing);
+		refreshSlotData();
+		updateOutgoing();
+	}
 	
 	inUpdate = false;
 }
@@ -208,7 +246,7 @@ void SmartModule::processMessage(const Message& incoming)
 				Message m = Message::RegistrationResult(controllerID, moduleID);
 				
 				// публикуем в транспорт ответ сразу же, потому что там его ждут незамедлительно
-				transport->write(m.getPayload(),m.getPayloadLength());						
+				send(m,true);
 				
 				// посылаем событие, что мы успешно зарегистрировались
 				registration(true);
@@ -247,6 +285,14 @@ void SmartModule::processMessage(const Message& incoming)
 		{
 			
 			DBGLN(F("Messages::Scan"));
+			
+			if(registered() && controllerID == incoming.controllerID)
+			{
+				// наш контроллер сканирует эфир - маяков в это время нет, а модули опрашиваются строго по одному,
+				// поэтому сбрасываем расписание, и всё, что не успели отправить в прошлой жизни
+				schedule.reset();
+				clearOutgoing();
+			}
 		
 			if( registered() && toMe(incoming) )
 			{
@@ -256,7 +302,7 @@ void SmartModule::processMessage(const Message& incoming)
 				Message m = Message::ScanResponse(controllerID, moduleID, moduleName,broadcastList.size(),observeList.size());
 				
 				// публикуем в транспорт ответ сразу же, потому что там его ждут незамедлительно
-				transport->write(m.getPayload(),m.getPayloadLength());			
+				send(m,true);
 			}
 		}
 		break;
@@ -305,8 +351,8 @@ void SmartModule::processMessage(const Message& incoming)
 	
 				Message m = Message::Pong(controllerID, moduleID);
 				
-				// публикуем в транспорт ответ сразу же, потому что там его ждут незамедлительно
-				transport->write(m.getPayload(),m.getPayloadLength());
+				// публикуем в транспорт ответ в своём слоте расписания
+				send(m);
 
 			}
 		}
@@ -326,10 +372,10 @@ void SmartModule::processMessage(const Message& incoming)
 */		
 		{
 			DBGLN(F("Messages::Pong"));
-			//TODO: сообщение "понг" мы игнорируем, хотя здесь можно и узнавать, какие модули онлайн
 			if(registered() && controllerID == incoming.controllerID)
 			{
-				// зарегистрированы, и сообщение послал наш контроллер, можно выставлять флаг, что данный модуль онлайн				
+				// зарегистрированы, и ответ на пинг подслушан у модуля нашей системы - выставляем флаг, что данный модуль онлайн
+				setModuleOnline(incoming.moduleID);
 			}
 		}
 		break;
@@ -377,7 +423,7 @@ void SmartModule::processMessage(const Message& incoming)
 					
 					DBGLN(F("Send back BroadcastSlotData message."));
 					
-					transport->write(m.getPayload(),m.getPayloadLength());
+					send(m);
 				}
 				
 			}
@@ -449,7 +495,7 @@ void SmartModule::processMessage(const Message& incoming)
 					
 					DBGLN(F("Send back ObserveSlotData message."));
 					
-					transport->write(m.getPayload(),m.getPayloadLength());
+					send(m);
 					
 				}
 			}
@@ -462,7 +508,8 @@ void SmartModule::processMessage(const Message& incoming)
 	сообщение "данные слота"
 	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
 	
-		отсылается контроллером в эфир для конкретного модуля, который зарегистрировал в контроллере свой входящий слот. Структура:
+		отсылается контроллером в эфир для конкретного модуля, который зарегистрировал в контроллере свой входящий слот,
+		или на широковещательный адрес. Структура:
 		
 			ID контроллера
 			ID модуля
@@ -477,8 +524,9 @@ void SmartModule::processMessage(const Message& incoming)
 		{
 			DBGLN(F("Messages::AnyDataBroadcast"));
 			
-			// пришли данные входящего слота, который мы зарегистрировали на контроллере
-			if( registered() && toMe(incoming) )
+			// пришли данные входящего слота, который мы зарегистрировали на контроллере, или контроллер разослал данные слота всем -
+			// тогда мы их берём, если наблюдаем такой слот
+			if(registered() && controllerID == incoming.controllerID && (incoming.isBroadcast() || incoming.moduleID == moduleID))
 			{
 				
 				updateObserveSlot(incoming);
@@ -526,7 +574,7 @@ void SmartModule::processMessage(const Message& incoming)
 						
 						DBGLN(F("Send back AnyDataResponse message."));
 						
-						transport->write(m.getPayload(),m.getPayloadLength());						
+						send(m);						
 							
 						
 						break;
@@ -577,9 +625,10 @@ void SmartModule::processMessage(const Message& incoming)
 			// эти два сообшения по нагрузке - идентичны, поэтому можно их обрабатывать в одной ветке, и с одинаковой логикой
 			DBGLN(F("Messages::BroadcastSlotData or Messages::AnyDataResponse"));
 			
-			// В принципе, если мы зарегистрированы - то можно смотреть этот слот во входящих у нас,
-			// главное - чтобы модуль-отправитель - был не наш, и всё.
-			if(registered() && controllerID == incoming.controllerID && incoming.moduleID != moduleID)
+			// смотрим этот слот во входящих у нас, главное - чтобы сообщение было из нашей системы и модуль-отправитель - был не наш.
+			// Флаг регистрации не проверяем: после перезагрузки он сброшен, а ID контроллера восстановлен из конфига,
+			// и правила модуля должны слышать данные сразу, не дожидаясь повторной регистрации.
+			if(controllerID == incoming.controllerID && incoming.moduleID != moduleID)
 			{
 				// мы зарегистрированы в системе, и отправили это сообщение не мы - значит, можно искать его в наблюдаемых входящих.
 				updateObserveSlot(incoming);
@@ -615,7 +664,7 @@ void SmartModule::processMessage(const Message& incoming)
 						
 					DBGLN(F("Send back EventResponse message."));
 						
-					transport->write(m.getPayload(),m.getPayloadLength());
+					send(m);
 					
 					
 					if(e)
@@ -649,7 +698,139 @@ void SmartModule::processMessage(const Message& incoming)
 		}
 		break;
 		
+		case Messages::OnlineModulesList: // сообщение "список онлайн-модулей"
+/*
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	сообщение "список онлайн-модулей"
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+		отсылается контроллером в ответ на событие "запрос модулей онлайн", или на широковещательный адрес при изменении списка модулей на связи, структура:
+
+			ID контроллера
+			ID модуля
+			Тип сообщения - "список онлайн-модулей"
+			нагрузка:			
+				- Битовая маска онлайн-модулей (32 байта)
+*/
+		{
+			DBGLN(F("Messages::OnlineModulesList"));
+			
+			if(registered() && controllerID == incoming.controllerID && (incoming.isBroadcast() || incoming.moduleID == moduleID)
+				&& incoming.getPayloadLength() >= MESSAGE_HEADER_SIZE + ONLINE_MODULES_MASK_SIZE)
+			{
+				memcpy(onlineModules,incoming.get(0),ONLINE_MODULES_MASK_SIZE);
+			}
+		}
+		break;
+		
+		case Messages::ConfigurationRequest: // сообщение "запрос конфигурации"
+/*
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	сообщение "запрос конфигурации"
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	
+		отсылается контроллером на модуль, для запроса информации о его конфигурации, структура:
+		
+			ID контроллера
+			ID модуля
+			Тип сообщения - "запрос конфигурации"
+*/
+		{
+			DBGLN(F("Messages::ConfigurationRequest"));
+			
+			if( registered() && toMe(incoming) )
+			{
+				Message m = Message::ConfigurationResponse(controllerID, moduleID, configSlots.size());
+				
+				DBGLN(F("Send back ConfigurationResponse message."));
+				
+				send(m);
+			}
+		}
+		break;
+		
+		case Messages::ConfigurationSlotRequest: // сообщение "запрос слота конфигурации"
+/*
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	сообщение "запрос слота конфигурации"
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+		отсылается контроллером на модуль для запроса определённого слота конфигурации, структура:
+
+			ID контроллера
+			ID модуля
+			Тип сообщения - "запрос слота конфигурации"
+			нагрузка:			
+				- Номер слота конфигурации (1 байт)
+*/
+		{
+			DBGLN(F("Messages::ConfigurationSlotRequest"));
+			
+			if( registered() && toMe(incoming) )
+			{
+				sendConfigSlot(incoming.get<uint8_t>(0));
+			}
+		}
+		break;
+		
+		case Messages::SaveConfigurationSlot: // сообщение "сохранить слот конфигурации"
+/*
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	сообщение "сохранить слот конфигурации"
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	
+		отсылается контроллером на модуль для сохранения слота конфигурации, структура:
+
+			ID контроллера
+			ID модуля
+			Тип сообщения - "сохранить слот конфигурации"
+			нагрузка:			
+				- Номер слота конфигурации (1 байт)
+				- Длина данных слота (2 байта)
+				- Данные слота конфигурации
+*/
+		{
+			DBGLN(F("Messages::SaveConfigurationSlot"));
+			
+			if( registered() && toMe(incoming) )
+			{
+				saveConfigSlot(incoming);
+			}
+		}
+		break;
+		
+		case Messages::ConfigurationResponse:
+		case Messages::ConfigurationSlotResponse:
+		case Messages::ConfigurationSlotSaved:
+		{
+			// ответы модулей на запросы конфигурации мы, как модуль, игнорируем
+		}
+		break;
+		
+		case Messages::Beacon: // сообщение "маяк расписания"
+/*
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	сообщение "маяк расписания"
+	---------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	
+		отсылается контроллером на широковещательный адрес в начале каждого кадра расписания доступа к шине, структура:
 		
+			ID контроллера
+			ID модуля = 0xFF
+			Тип сообщения - "маяк расписания"
+			нагрузка:
+				- длительность одного слота расписания, миллисекунд (2 байта)
+				- кол-во модулей в расписании (1 байт)
+				- ID модулей в порядке следования их слотов (по 1 байту на модуль)
+*/
+		{
+			if(registered() && controllerID == incoming.controllerID)
+			{
+				// маяк от нашего контроллера, синхронизируемся с расписанием
+				syncSchedule(incoming);
+			}
+		}
+		break;
 		
 	} // switch
 }
@@ -671,12 +852,16 @@ void SmartModule::updateObserveSlot(const Message& m)
 		data = m.getPayload() + MESSAGE_HEADER_SIZE + 7; // становимся на начало данных слота
 	}
 		
+	bool observed = false;
+	
 	// ищем такой слот во входящих
 	for(size_t i=0;i<observeList.size();i++)
 	{
 		AnyDataTimer* dt = &(observeList[i]);
 		if(dt->data->getID() == slotID)
 		{
+			observed = true;
+			
 			// нашли, можно обновлять данные
 			
 			DBG(F("Update observe slot #"));
@@ -697,7 +882,510 @@ void SmartModule::updateObserveSlot(const Message& m)
 			
 			break;
 		}
-	} // for	
+	} // for
+	
+	bool needed = rules.dependsOn(slotID);
+	
+	if(!observed && !needed)
+		return;
+	
+	// правила, которые пишут в этот слот, главнее пришедших данных
+	if(observed)
+		reassertRules(slotID);
+	
+	// чужой слот, который мы не наблюдаем, но от которого зависят наши правила, - запоминаем услышанное значение
+	if(!observed && !findSlot(slotID))
+	{
+		if(!rememberHeardSlot(slotID,static_cast<uint8_t>(slotType),data,dataLength))
+		{
+			// у слота больше нет данных - зависящие от него правила переходим на безопасное значение
+			slotValueLost(slotID);
+			return;
+		}
+	}
+	
+	// у наблюдаемого слота без данных правила уже переведены из informDataChanged, через reset()
+	rules.slotChanged(slotID);
+	applyRules();
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+AnyData* SmartModule::findSlot(uint16_t slotID)
+{
+	for(size_t i=0;i<broadcastList.size();i++)
+	{
+		if(broadcastList[i]->getID() == slotID)
+			return broadcastList[i];
+	}
+	
+	for(size_t i=0;i<observeList.size();i++)
+	{
+		if(observeList[i].data->getID() == slotID)
+			return observeList[i].data;
+	}
+	
+	return NULL;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool SmartModule::getSlotValue(uint16_t slotID, int32_t& result)
+{
+	AnyData* slot = findSlot(slotID);
+	
+	if(slot)
+		return slot->hasData() && AnyData::toNumber(slot->getType(),slot->getData(),slot->getDataLength(),result);
+	
+	for(uint8_t i=0;i<heardSlotsCount;i++)
+	{
+		if(heardSlots[i].slotID == slotID)
+		{
+			result = heardSlots[i].value;
+			return heardSlots[i].hasValue;
+		}
+	}
+	
+	return false;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool SmartModule::rememberHeardSlot(uint16_t slotID, uint8_t dataType, const uint8_t* data, uint16_t dataLength)
+{
+	HeardSlot* hs = NULL;
+	
+	for(uint8_t i=0;i<heardSlotsCount;i++)
+	{
+		if(heardSlots[i].slotID == slotID)
+		{
+			hs = &(heardSlots[i]);
+			break;
+		}
+	}
+	
+	if(!hs)
+	{
+		// места нет - затираем по кругу
+		if(heardSlotsCount < MODULE_RULE_HEARD_SLOTS)
+			hs = &(heardSlots[heardSlotsCount++]);
+		else
+		{
+			hs = &(heardSlots[nextHeardSlot]);
+			nextHeardSlot = (nextHeardSlot + 1) % MODULE_RULE_HEARD_SLOTS;
+		}
+		
+		hs->slotID = slotID;
+	}
+	
+	int32_t value;
+	hs->hasValue = data && AnyData::toNumber(static_cast<DataType>(dataType),data,dataLength,value);
+	hs->heardAt = uptime();
+	
+	if(hs->hasValue)
+		hs->value = value;
+	
+	return hs->hasValue;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void SmartModule::expireHeardSlots()
+{
+	uint32_t now = uptime();
+	
+	for(uint8_t i=0;i<heardSlotsCount;i++)
+	{
+		if(!heardSlots[i].hasValue || (now - heardSlots[i].heardAt) < MODULE_RULE_HEARD_TIMEOUT)
+			continue;
+		
+		DBG(F("[TIMEOUT] heard slot #"));
+		DBGLN(heardSlots[i].slotID);
+		
+		// модуль-источник молчит дольше нескольких периодов обновления - не верим старому значению
+		heardSlots[i].hasValue = false;
+		slotValueLost(heardSlots[i].slotID);
+	}
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void SmartModule::slotValueLost(uint16_t slotID)
+{
+	// правила, зависящие от слота, не ждут его данных со старым результатом, а сразу считают условие невыполненным
+	uint32_t changed = rules.slotLost(slotID);
+	
+	for(uint8_t i=0;i<RULES_MAX_COUNT;i++)
+	{
+		if(changed & (1ul << i))
+			writeRuleOutput(i);
+	}
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool SmartModule::addRule(uint8_t number, const uint8_t* code, uint8_t length)
+{
+	if(!RuleEngine::validate(code,length))
+		return false;
+	
+	// значения чужих слотов из условий правил хранятся в heardSlots - все они должны туда поместиться,
+	// иначе слоты вытесняли бы друг друга и правила считали бы по пропавшим значениям
+	uint16_t foreign[MODULE_RULE_HEARD_SLOTS];
+	uint8_t foreignCount = 0;
+	
+	for(uint8_t i=0;i<RULES_MAX_COUNT;i++)
+	{
+		const uint8_t* ruleCode = code;
+		uint8_t ruleLength = length;
+		
+		if(i != number)
+		{
+			if(!rules.exists(i))
+				continue;
+			
+			ruleCode = rules.getCode(i);
+			ruleLength = rules.getLength(i);
+		}
+		
+		uint8_t pos = 0;
+		uint16_t slotID;
+		while(RuleEngine::nextConditionSlot(ruleCode,ruleLength,pos,slotID))
+		{
+			if(findSlot(slotID))
+				continue;
+			
+			bool known = false;
+			for(uint8_t k=0;k<foreignCount;k++)
+			{
+				if(foreign[k] == slotID)
+				{
+					known = true;
+					break;
+				}
+			}
+			
+			if(known)
+				continue;
+			
+			if(foreignCount >= MODULE_RULE_HEARD_SLOTS)
+			{
+				DBGLN(F("Rule rejected: too many foreign slots!"));
+				return false;
+			}
+			
+			foreign[foreignCount++] = slotID;
+		}
+	}
+	
+	if(!rules.set(number,code,length))
+		return false;
+	
+	// данные слотов из условия уже могут быть
+	applyRules();
+	return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void SmartModule::applyRules()
+{
+	// правило записало слот, от которого зависят другие правила, - их вычислит следующий проход
+	if(inRules)
+		return;
+	
+	inRules = true;
+	
+	// правила могут зациклиться друг на друга, поэтому проходов - не больше, чем правил
+	for(uint8_t pass=0;pass<RULES_MAX_COUNT;pass++)
+	{
+		uint32_t changed = rules.update();
+		if(!changed)
+			break;
+		
+		for(uint8_t i=0;i<RULES_MAX_COUNT;i++)
+		{
+			if(changed & (1ul << i))
+				writeRuleOutput(i);
+		}
+	}
+	
+	inRules = false;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void SmartModule::writeRuleOutput(uint8_t number)
+{
+	uint16_t slotID;
+	uint8_t dataType;
+	uint8_t data[sizeof(int32_t)];
+	uint16_t dataLength = rules.getOutput(number,slotID,dataType,data);
+	
+	if(!dataLength)
+		return;
+	
+	AnyData* target = findSlot(slotID);
+	if(!target || target->getType() != static_cast<DataType>(dataType))
+		return;
+	
+	if(target->hasData() && !memcmp(target->getData(),data,dataLength))
+		return;
+	
+	DBG(F("Rule #"));
+	DBG(number);
+	DBG(F(" writes slot #"));
+	DBGLN(slotID);
+	
+	target->setRaw(target->getType(),data,dataLength);
+	
+	// исходящий слот - сообщаем контроллеру, и от него могут зависеть другие правила
+	informDataChanged(target);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void SmartModule::reassertRules(uint16_t slotID)
+{
+	for(uint8_t i=0;i<RULES_MAX_COUNT;i++)
+	{
+		if(rules.exists(i) && rules.getTarget(i) == slotID && rules.getState(i) != RULE_STATE_UNKNOWN)
+			writeRuleOutput(i);
+	}
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint8_t SmartModule::addConfigSlot(const char* name, ConfigSlotType type, uint16_t maxLength)
+{
+	ConfigSlot slot;
+	slot.name = name;
+	slot.type = type;
+	slot.maxLength = maxLength;
+	slot.address = configEndAddress;
+	
+	configEndAddress += sizeof(uint16_t) + maxLength;
+	configSlots.push_back(slot);
+	
+	return configSlots.size() - 1;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint16_t SmartModule::readConfig(uint8_t slotNumber, uint8_t* dest, uint16_t maxLength)
+{
+	if(slotNumber >= configSlots.size())
+		return 0;
+	
+	ConfigSlot* slot = &(configSlots[slotNumber]);
+	
+	uint16_t length;
+	storage->readBlock(slot->address,(uint8_t*)&length,sizeof(uint16_t));
+	
+	// чистая EEPROM (0xFFFF) или мусор - данных нет
+	if(length > slot->maxLength)
+		return 0;
+	
+	storage->readBlock(slot->address + sizeof(uint16_t),dest,length < maxLength ? length : maxLength);
+	
+	return length;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool SmartModule::writeConfig(uint8_t slotNumber, const uint8_t* data, uint16_t length)
+{
+	if(slotNumber >= configSlots.size())
+		return false;
+	
+	ConfigSlot* slot = &(configSlots[slotNumber]);
+	
+	if(length > slot->maxLength)
+		return false;
+	
+	// неизменившиеся байты не перезаписываем, сброс хранилища - один на всю пачку сохранений, в updateConfigFlush()
+	storage->updateBlock(slot->address,(const uint8_t*)&length,sizeof(uint16_t));
+	storage->updateBlock(slot->address + sizeof(uint16_t),data,length);
+	
+	configSavedAt = uptime();
+	
+	if(!configDirty)
+		configDirtySince = configSavedAt;
+	
+	configDirty = true;
+	
+	return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void SmartModule::updateConfigFlush()
+{
+	uint32_t now = uptime();
+	
+	// сбрасываем после паузы в сохранениях, но не позже CONFIG_FLUSH_MAX_DELAY от первого несброшенного,
+	// иначе непрерывный поток сохранений не дождётся подтверждений
+	if(configDirty && (now - configSavedAt >= CONFIG_FLUSH_DELAY || now - configDirtySince >= CONFIG_FLUSH_MAX_DELAY))
+	{
+		DBGLN(F("[CONFIG] flush storage."));
+		
+		configDirty = false;
+		storage->flush();
+		
+		// все накопленные подтверждения теперь правдивы
+		configAcksFlushed = configAcks.size();
+	}
+	
+	// подтверждения отсылаем по одному, пока есть место в очереди, чтобы не вытеснить из неё другие сообщения
+	while(configAcksFlushed && outgoing.size() < TDMA_MAX_QUEUED_MESSAGES)
+	{
+		uint8_t slotNumber = configAcks[0];
+		
+		for(size_t i=1;i<configAcks.size();i++)
+			configAcks[i-1] = configAcks[i];
+		
+		configAcks.pop();
+		configAcksFlushed--;
+		
+		Message m = Message::ConfigurationSlotSaved(controllerID, moduleID, slotNumber, true, "OK");
+		
+		DBGLN(F("Send back ConfigurationSlotSaved message."));
+		
+		send(m);
+	}
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void SmartModule::sendConfigSlot(uint8_t slotNumber)
+{
+	DBG(F("Requested configuration slot #"));
+	DBGLN(slotNumber);
+	
+	if(slotNumber >= configSlots.size())
+		return;
+	
+	ConfigSlot* slot = &(configSlots[slotNumber]);
+	
+	// страницу слота читаем из хранилища целиком, одним блоком
+	uint16_t pageLength = sizeof(uint16_t) + slot->maxLength;
+	uint8_t* page = new uint8_t[pageLength];
+	storage->readBlock(slot->address,page,pageLength);
+	
+	uint16_t dataLength;
+	memcpy(&dataLength,page,sizeof(uint16_t));
+	
+	if(dataLength > slot->maxLength)
+		dataLength = 0; // данных нет
+	
+	Message m = Message::ConfigurationSlotResponse(controllerID, moduleID, slotNumber, slot->type, slot->name, page + sizeof(uint16_t), dataLength);
+	delete [] page;
+	
+	DBGLN(F("Send back ConfigurationSlotResponse message."));
+	
+	send(m);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void SmartModule::saveConfigSlot(const Message& m)
+{
+	uint8_t slotNumber = m.get<uint8_t>(0);
+	uint16_t dataLength = m.get<uint16_t>(1);
+	
+	DBG(F("Save configuration slot #"));
+	DBGLN(slotNumber);
+	
+	bool success = false;
+	const char* answer;
+	
+	if(m.getPayloadLength() < MESSAGE_HEADER_SIZE + 3 + dataLength)
+		answer = "BAD_FRAME";
+	else
+		if(slotNumber >= configSlots.size())
+			answer = "BAD_SLOT";
+		else
+			if(!writeConfig(slotNumber,m.get(3),dataLength))
+				answer = "TOO_LONG";
+			else
+			{
+				answer = "OK";
+				success = true;
+			}
+	
+	if(success)
+	{
+		// подтверждение уйдёт только после того, как данные реально сброшены в хранилище, - в updateConfigFlush()
+		configAcks.push_back(slotNumber);
+		configuration(slotNumber); // вызываем событие "слот конфигурации изменён"
+		return;
+	}
+	
+	Message answerMessage = Message::ConfigurationSlotSaved(controllerID, moduleID, slotNumber, success, answer);
+	
+	DBGLN(F("Send back ConfigurationSlotSaved message."));
+	
+	send(answerMessage);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void SmartModule::syncSchedule(const Message& m)
+{
+	uint16_t slotDuration = m.get<uint16_t>(0);
+	uint8_t modulesCount = m.get<uint8_t>(2);
+	
+	if(m.getPayloadLength() < MESSAGE_HEADER_SIZE + 3 + modulesCount)
+		return; // битый маяк
+	
+	// ищем себя в списке модулей, позиция в списке + 1 - наш слот (нулевой слот - у контроллера)
+	uint8_t mySlot = TDMA_NO_SLOT;
+	const uint8_t* ids = m.get(3);
+	
+	for(uint8_t i=0;i<modulesCount;i++)
+	{
+		if(ids[i] == moduleID)
+		{
+			mySlot = i + 1;
+			break;
+		}
+	}
+	
+	schedule.sync(uptime(), slotDuration, modulesCount, mySlot);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void SmartModule::send(const Message& m, bool immediate)
+{
+	if(immediate || (!outgoing.size() && schedule.canTransmit()))
+	{
+		// можно передавать прямо сейчас
+		transport->write(m.getPayload(),m.getPayloadLength());
+		return;
+	}
+	
+	// ждём своего слота в расписании
+	if(outgoing.size() >= TDMA_MAX_QUEUED_MESSAGES)
+	{
+		DBGLN(F("[TDMA] outgoing queue full, drop oldest!"));
+		transport->getStats().queueOverflows++;
+		
+		delete [] outgoing[0].payload;
+		for(size_t i=1;i<outgoing.size();i++)
+		{
+			outgoing[i-1] = outgoing[i];
+		}
+		outgoing.pop();
+	}
+	
+	OutgoingMessage om;
+	om.payloadLength = m.getPayloadLength();
+	om.payload = new uint8_t[om.payloadLength];
+	memcpy(om.payload,m.getPayload(),om.payloadLength);
+	
+	outgoing.push_back(om);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void SmartModule::updateOutgoing()
+{
+	// отсылаем сообщения по порядку, пока не закончится наше окно в расписании
+	size_t sent = 0;
+	while(sent < outgoing.size() && schedule.canTransmit())
+	{
+		transport->write(outgoing[sent].payload,outgoing[sent].payloadLength);
+		delete [] outgoing[sent].payload;
+		sent++;
+	}
+	
+	if(!sent)
+		return;
+	
+	for(size_t i=sent;i<outgoing.size();i++)
+	{
+		outgoing[i-sent] = outgoing[i];
+	}
+	
+	for(size_t i=0;i<sent;i++)
+	{
+		outgoing.pop();
+	}
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void SmartModule::clearOutgoing()
+{
+	for(size_t i=0;i<outgoing.size();i++)
+	{
+		delete [] outgoing[i].payload;
+	}
+	
+	outgoing.empty();
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 bool SmartModule::toMe(const Message& m)
@@ -758,15 +1446,82 @@ void SmartModule::informDataChanged(AnyData* data)
 	// проверяем - если данные зарегистрированы как исходящие - помещаем событие SlotDataChanged в очередь событий на отправку,
 	// при следующем опросе контроллером - он перечитает это дело с нас.
 	
+	// Кроме того, сами данные уходят на шину в нашем ближайшем окне расписания - модули, чьи правила зависят от слота,
+	// узнают об изменении, не дожидаясь опроса контроллером. Событие остаётся на случай, если данные потеряются.
+	
 	for(size_t i=0;i<broadcastList.size();i++)
 	{
 		if(broadcastList[i] == data)
 		{
+			pushSlotData(data);
 			addEvent(Events::SlotDataChanged, data);
 			break;
 		}
 	}		
 	
+	// данных у слота нет - правила, зависящие от него, сразу переходят на безопасное значение
+	if(!data->hasData())
+	{
+		slotValueLost(data->getID());
+		return;
+	}
+	
+	// от данных слота могут зависеть правила модуля - вычисляем их сразу
+	rules.slotChanged(data->getID());
+	applyRules();
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void SmartModule::pushSlotData(AnyData* data)
+{
+	if(!registered())
+		return;
+	
+	Message m = Message::BroadcastSlotData(controllerID,moduleID,data);
+	
+	// данные этого слота уже ждут своего окна - заменяем их свежими, чтобы не занимать очередь устаревшими значениями
+	for(size_t i=0;i<outgoing.size();i++)
+	{
+		OutgoingMessage* om = &(outgoing[i]);
+		if(om->payloadLength < MESSAGE_HEADER_SIZE + 2)
+			continue;
+		
+		uint16_t type, slotID;
+		memcpy(&type,om->payload + MESSAGE_HEADER_SIZE - sizeof(type),sizeof(type));
+		memcpy(&slotID,om->payload + MESSAGE_HEADER_SIZE,sizeof(slotID));
+		
+		if(type != static_cast<uint16_t>(Messages::BroadcastSlotData) || slotID != data->getID())
+			continue;
+		
+		delete [] om->payload;
+		om->payloadLength = m.getPayloadLength();
+		om->payload = new uint8_t[om->payloadLength];
+		memcpy(om->payload,m.getPayload(),om->payloadLength);
+		return;
+	}
+	
+	send(m);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void SmartModule::refreshSlotData()
+{
+	// по одному исходящему слоту за раз, так что каждый повторяется на шине раз в MODULE_SLOT_REFRESH_INTERVAL:
+	// без этого неизменное значение протухло бы у модулей, чьи правила от него зависят
+	if(!registered() || !broadcastList.size())
+		return;
+	
+	uint32_t now = uptime();
+	if(now - slotRefreshAt < MODULE_SLOT_REFRESH_INTERVAL / broadcastList.size())
+		return;
+	
+	slotRefreshAt = now;
+	
+	if(nextRefreshSlot >= broadcastList.size())
+		nextRefreshSlot = 0;
+	
+	AnyData* data = broadcastList[nextRefreshSlot++];
+	
+	if(data->hasData())
+		pushSlotData(data);
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 bool SmartModule::eventExists(Event* e)
@@ -5,11 +5,20 @@
 #include "../message/message.h"
 #include "../utils/vector.h"
 #include "../data/anydata.h"
+#include "../transport/tdma.h"
+#include "../rules/rules.h"
 
 #include <inttypes.h>
 #include <limits.h>
 #include <Arduino.h>
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#if MODULE_RULE_HEARD_TIMEOUT <= 2*MODULE_SLOT_REFRESH_INTERVAL
+	#error "MODULE_RULE_HEARD_TIMEOUT must be more than two MODULE_SLOT_REFRESH_INTERVAL: one lost refresh must not expire a heard slot"
+#endif
+#if CONFIG_FLUSH_MAX_DELAY >= CONFIG_SAVE_TIMEOUT
+	#error "CONFIG_FLUSH_MAX_DELAY must be less than CONFIG_SAVE_TIMEOUT: the controller stops waiting for the save answer"
+#endif
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 class AnyData; // forward declaration
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 #pragma pack(push,1)
@@ -23,11 +32,43 @@ typedef struct
 } AnyDataTimer;
 #pragma pack(pop)
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#pragma pack(push,1)
+typedef struct
+{
+	uint8_t* payload; // сырое сообщение, ожидающее своего слота в расписании
+	uint16_t payloadLength;
+	
+} OutgoingMessage;
+#pragma pack(pop)
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#pragma pack(push,1)
+typedef struct
+{
+	const char* name; // имя слота
+	ConfigSlotType type; // тип слота
+	uint16_t maxLength; // максимальная длина данных слота
+	uint16_t address; // адрес страницы слота в хранилище: длина данных (2 байта) + maxLength байт данных
+	
+} ConfigSlot;
+#pragma pack(pop)
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// не упакована: value передаётся по ссылке в AnyData::toNumber и должно быть выровнено
+typedef struct
+{
+	uint16_t slotID; // чужой слот, от которого зависят правила модуля
+	int32_t value; // последнее услышанное на шине значение (см. AnyData::toNumber)
+	uint32_t heardAt; // когда его услышали: через MODULE_RULE_HEARD_TIMEOUT без новых данных значение протухает
+	bool hasValue;
+	
+} HeardSlot;
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 typedef Vector<AnyData*> AnyDataList;
 typedef Vector<AnyDataTimer> AnyDataTimerList;
 typedef Vector<Event*> EventsList;
+typedef Vector<OutgoingMessage> OutgoingList;
+typedef Vector<ConfigSlot> ConfigSlotsList;
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-class SmartModule
+class SmartModule : public RuleInputs
 {
 	public:
 	
@@ -53,6 +94,29 @@ class SmartModule
 		// добавление наблюдения за данными
 		void observe(AnyData& data, uint32_t observeFrequency, uint32_t resetTimeout=ULONG_MAX);
 		
+		// добавление слота конфигурации, возвращает номер слота. Слоты добавляются до begin(), всегда в одном и том же порядке -
+		// от этого зависит их размещение в хранилище
+		uint8_t addConfigSlot(const char* name, ConfigSlotType type, uint16_t maxLength);
+		uint8_t getConfigSlotsCount() { return configSlots.size(); }
+		
+		// читает сохранённые данные слота конфигурации, возвращает их длину (0 - данных нет)
+		uint16_t readConfig(uint8_t slotNumber, uint8_t* dest, uint16_t maxLength);
+		
+		// сохраняет данные слота конфигурации, сброс хранилища - отложенный (см. CONFIG_FLUSH_DELAY)
+		bool writeConfig(uint8_t slotNumber, const uint8_t* data, uint16_t length);
+		
+		template<typename T>
+		bool getConfig(uint8_t slotNumber, T& result)
+		{
+			return readConfig(slotNumber,(uint8_t*)&result,sizeof(T)) == sizeof(T);
+		}
+		
+		template<typename T>
+		bool setConfig(uint8_t slotNumber, const T& val)
+		{
+			return writeConfig(slotNumber,(const uint8_t*)&val,sizeof(T));
+		}
+		
 		uint8_t getID() { return moduleID; }
 		uint32_t getControllerID() { return controllerID; }
 		const char* getModuleName() { return moduleName; }
@@ -60,6 +124,22 @@ class SmartModule
 		// начинаем регистрацию
 		void startRegistration(uint32_t timeout);
 		
+		// модуль с указанным ID на связи? Список рассылает контроллер, плюс мы слышим ответы на пинги других модулей
+		bool isModuleOnline(uint8_t id) { return (onlineModules[id/8] & (1 << (id%8))); }
+		
+		// локальные правила модуля (формат кода - см. src/rules/rules.h). Правило вычисляется сразу, как только модуль
+		// получил или услышал на шине данные слота из его условия или изменились данные собственного слота модуля, -
+		// в том же вызове update() или set(), без опроса контроллером. Целевой слот правила - исходящий или наблюдаемый
+		// слот модуля; пока у правила есть результат, его значение восстанавливается и поверх данных, пришедших с контроллера.
+		// Данные слота условия пропали или протухли - правило переходит на значение "условие не выполняется".
+		// false - код неверен или чужих слотов во всех правилах больше, чем MODULE_RULE_HEARD_SLOTS
+		bool addRule(uint8_t number, const uint8_t* code, uint8_t length);
+		bool removeRule(uint8_t number) { return rules.remove(number); }
+		uint8_t getRuleState(uint8_t number) { return rules.exists(number) ? rules.getState(number) : RULE_STATE_UNKNOWN; }
+		
+		// значение слота для правил: исходящие и наблюдаемые слоты модуля, а также чужие слоты, услышанные на шине
+		bool getSlotValue(uint16_t slotID, int32_t& result);
+		
 	protected:
 	
 		friend class AnyData;
@@ -78,6 +158,40 @@ class SmartModule
 		void processMessage(const Message& m);
 		
 		void updateObserveSlot(const Message& m);
+		AnyData* findSlot(uint16_t slotID);
+		
+		RuleEngine rules;
+		bool inRules; // идёт вычисление правил
+		HeardSlot heardSlots[MODULE_RULE_HEARD_SLOTS];
+		uint8_t heardSlotsCount, nextHeardSlot;
+		bool rememberHeardSlot(uint16_t slotID, uint8_t dataType, const uint8_t* data, uint16_t dataLength); // false - значения нет
+		void expireHeardSlots();
+		void slotValueLost(uint16_t slotID);
+		
+		// значения исходящих слотов сами уходят на шину: при изменении и раз в MODULE_SLOT_REFRESH_INTERVAL
+		uint32_t slotRefreshAt;
+		uint8_t nextRefreshSlot;
+		void pushSlotData(AnyData* data);
+		void refreshSlotData();
+		void applyRules();
+		void writeRuleOutput(uint8_t number);
+		void reassertRules(uint16_t slotID);
+		
+		void sendConfigSlot(uint8_t slotNumber);
+		void saveConfigSlot(const Message& m);
+		void updateConfigFlush();
+		
+		// отсылает сообщение в транспорт: сразу, если immediate == true, иначе - в своём слоте расписания
+		void send(const Message& m, bool immediate=false);
+		void updateOutgoing();
+		void clearOutgoing();
+		void syncSchedule(const Message& m);
+		
+		uint8_t onlineModules[ONLINE_MODULES_MASK_SIZE]; // битовая маска модулей на связи
+		void setModuleOnline(uint8_t id) { onlineModules[id/8] |= (1 << (id%8)); }
+		
+		TDMASchedule schedule; // расписание доступа к шине
+		OutgoingList outgoing; // сообщения, ожидающие своего слота
 			
 		_Storage* storage;
 		Transport* transport;
@@ -91,6 +205,14 @@ class SmartModule
 		AnyDataList broadcastList;
 		AnyDataTimerList observeList;
 		
+		ConfigSlotsList configSlots;
+		uint16_t configEndAddress; // адрес, с которого разместится следующий слот конфигурации
+		bool configDirty; // есть несброшенные сохранения слотов конфигурации
+		uint32_t configSavedAt; // когда последний раз сохраняли слот конфигурации
+		uint32_t configDirtySince; // когда сохранили первый из несброшенных слотов конфигурации
+		Vector<uint8_t> configAcks; // номера сохранённых слотов, подтверждения которых ещё не отосланы
+		uint8_t configAcksFlushed; // сколько первых из них уже сброшено в хранилище и может быть подтверждено
+		
 		// registration related
 		bool inRegMode;
 		uint32_t regTimeout, regStartedAt;
@@ -0,0 +1,358 @@
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "rules.h"
+#include "../data/anydata.h"
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// RuleEngine
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+RuleEngine::RuleEngine(RuleInputs& in)
+{
+	inputs = &in;
+	dirty = 0;
+
+	for(uint8_t i=0;i<RULES_MAX_COUNT;i++)
+	{
+		rules[i].code = NULL;
+		rules[i].length = 0;
+		rules[i].state = RULE_STATE_UNKNOWN;
+	}
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+RuleEngine::~RuleEngine()
+{
+	for(uint8_t i=0;i<RULES_MAX_COUNT;i++)
+	{
+		delete [] rules[i].code;
+	}
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint8_t RuleEngine::getCount()
+{
+	uint8_t cnt = 0;
+	for(uint8_t i=0;i<RULES_MAX_COUNT;i++)
+	{
+		if(rules[i].code)
+			cnt++;
+	}
+
+	return cnt;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint16_t RuleEngine::getTarget(uint8_t number)
+{
+	uint16_t slotID = 0;
+	if(exists(number))
+		memcpy(&slotID,rules[number].code,sizeof(slotID));
+
+	return slotID;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool RuleEngine::validate(const uint8_t* code, uint8_t length)
+{
+	if(length < RULE_HEADER_SIZE + 1 || length > RULE_MAX_LENGTH)
+		return false;
+
+	// тип целевого слота должен собираться из числа
+	uint8_t buff[sizeof(int32_t)];
+	if(!AnyData::fromNumber(static_cast<DataType>(code[2]),0,buff))
+		return false;
+
+	uint8_t depth = 0;
+
+	for(uint8_t pos = RULE_HEADER_SIZE; pos < length;)
+	{
+		switch(static_cast<RuleOp>(code[pos++]))
+		{
+			case RuleOp::Slot:
+			case RuleOp::Number:
+			{
+				uint8_t operandLength = static_cast<RuleOp>(code[pos-1]) == RuleOp::Slot ? sizeof(uint16_t) : sizeof(int32_t);
+				if(pos + operandLength > length || depth >= RULE_STACK_SIZE)
+					return false;
+
+				pos += operandLength;
+				depth++;
+			}
+			break;
+
+			case RuleOp::Greater:
+			case RuleOp::GreaterOrEqual:
+			case RuleOp::Less:
+			case RuleOp::LessOrEqual:
+			case RuleOp::Equal:
+			case RuleOp::NotEqual:
+			case RuleOp::And:
+			case RuleOp::Or:
+			{
+				if(depth < 2)
+					return false;
+
+				depth--;
+			}
+			break;
+
+			case RuleOp::Not:
+			{
+				if(depth < 1)
+					return false;
+			}
+			break;
+
+			default:
+				return false;
+		}
+	}
+
+	return depth == 1;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool RuleEngine::nextConditionSlot(const uint8_t* code, uint8_t length, uint8_t& pos, uint16_t& slotID)
+{
+	if(pos < RULE_HEADER_SIZE)
+		pos = RULE_HEADER_SIZE;
+
+	while(pos < length)
+	{
+		RuleOp op = static_cast<RuleOp>(code[pos++]);
+
+		if(op == RuleOp::Slot)
+		{
+			memcpy(&slotID,code + pos,sizeof(slotID));
+			pos += sizeof(slotID);
+			return true;
+		}
+
+		if(op == RuleOp::Number)
+			pos += sizeof(int32_t);
+	}
+
+	return false;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool RuleEngine::set(uint8_t number, const uint8_t* code, uint8_t length)
+{
+	if(number >= RULES_MAX_COUNT || !validate(code,length))
+		return false;
+
+	remove(number);
+
+	Rule* r = &(rules[number]);
+	r->code = new uint8_t[length];
+	memcpy(r->code,code,length);
+	r->length = length;
+	r->state = RULE_STATE_UNKNOWN;
+
+	// индекс зависимостей: на каждый слот условия - одна запись
+	uint8_t pos = 0;
+	uint16_t slotID;
+	while(nextConditionSlot(code,length,pos,slotID))
+		addDependency(slotID,number);
+
+	// вычисляем сразу - вдруг данные всех слотов уже есть
+	dirty |= (1ul << number);
+
+	return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool RuleEngine::remove(uint8_t number)
+{
+	if(!exists(number))
+		return false;
+
+	removeDependencies(number);
+
+	delete [] rules[number].code;
+	rules[number].code = NULL;
+	rules[number].length = 0;
+	rules[number].state = RULE_STATE_UNKNOWN;
+	dirty &= ~(1ul << number);
+
+	return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+size_t RuleEngine::findDependency(uint16_t slotID)
+{
+	size_t lo = 0, hi = dependencies.size();
+
+	while(lo < hi)
+	{
+		size_t mid = (lo + hi)/2;
+
+		if(dependencies[mid].slotID < slotID)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void RuleEngine::addDependency(uint16_t slotID, uint8_t rule)
+{
+	size_t pos = findDependency(slotID);
+
+	// слот может встречаться в условии не один раз
+	for(size_t i=pos;i<dependencies.size() && dependencies[i].slotID == slotID;i++)
+	{
+		if(dependencies[i].rule == rule)
+			return;
+	}
+
+	RuleDependency d = {slotID, rule};
+	dependencies.push_back(d);
+
+	// раздвигаем, чтобы вставить на своё место
+	for(size_t i=dependencies.size()-1;i>pos;i--)
+	{
+		dependencies[i] = dependencies[i-1];
+	}
+
+	dependencies[pos] = d;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void RuleEngine::removeDependencies(uint8_t rule)
+{
+	size_t writeIdx = 0;
+
+	for(size_t i=0;i<dependencies.size();i++)
+	{
+		if(dependencies[i].rule != rule)
+			dependencies[writeIdx++] = dependencies[i];
+	}
+
+	while(dependencies.size() > writeIdx)
+		dependencies.pop();
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void RuleEngine::slotChanged(uint16_t slotID)
+{
+	for(size_t i=findDependency(slotID);i<dependencies.size() && dependencies[i].slotID == slotID;i++)
+	{
+		dirty |= (1ul << dependencies[i].rule);
+	}
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t RuleEngine::slotLost(uint16_t slotID)
+{
+	uint32_t changed = 0;
+
+	for(size_t i=findDependency(slotID);i<dependencies.size() && dependencies[i].slotID == slotID;i++)
+	{
+		uint8_t number = dependencies[i].rule;
+
+		if(rules[number].state != 0)
+		{
+			rules[number].state = 0;
+			changed |= (1ul << number);
+		}
+	}
+
+	return changed;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool RuleEngine::evaluate(uint8_t number, bool& result)
+{
+	const uint8_t* code = rules[number].code;
+	uint8_t length = rules[number].length;
+
+	int32_t stack[RULE_STACK_SIZE];
+	uint8_t depth = 0;
+
+	// код проверен при установке, поэтому границы стека и операндов здесь не проверяем
+	for(uint8_t pos = RULE_HEADER_SIZE; pos < length;)
+	{
+		RuleOp op = static_cast<RuleOp>(code[pos++]);
+
+		if(op == RuleOp::Slot)
+		{
+			uint16_t slotID;
+			memcpy(&slotID,code + pos,sizeof(slotID));
+			pos += sizeof(slotID);
+
+			if(!inputs->getSlotValue(slotID,stack[depth++]))
+				return false;
+
+			continue;
+		}
+
+		if(op == RuleOp::Number)
+		{
+			memcpy(&(stack[depth++]),code + pos,sizeof(int32_t));
+			pos += sizeof(int32_t);
+			continue;
+		}
+
+		if(op == RuleOp::Not)
+		{
+			stack[depth-1] = !stack[depth-1];
+			continue;
+		}
+
+		int32_t b = stack[--depth];
+		int32_t a = stack[depth-1];
+		int32_t r = 0;
+
+		switch(op)
+		{
+			case RuleOp::Greater: r = a > b; break;
+			case RuleOp::GreaterOrEqual: r = a >= b; break;
+			case RuleOp::Less: r = a < b; break;
+			case RuleOp::LessOrEqual: r = a <= b; break;
+			case RuleOp::Equal: r = a == b; break;
+			case RuleOp::NotEqual: r = a != b; break;
+			case RuleOp::And: r = a && b; break;
+			case RuleOp::Or: r = a || b; break;
+			default: break;
+		}
+
+		stack[depth-1] = r;
+	}
+
+	result = stack[0];
+	return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t RuleEngine::update()
+{
+	uint32_t changed = 0;
+
+	for(uint8_t i=0;dirty && i<RULES_MAX_COUNT;i++)
+	{
+		uint32_t bit = (1ul << i);
+		if(!(dirty & bit))
+			continue;
+
+		dirty &= ~bit;
+
+		bool result;
+		if(!evaluate(i,result))
+			continue; // не все данные есть - ждём
+
+		if(rules[i].state != result)
+		{
+			rules[i].state = result;
+			changed |= bit;
+		}
+	}
+
+	return changed;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint16_t RuleEngine::getOutput(uint8_t number, uint16_t& slotID, uint8_t& dataType, uint8_t* dest)
+{
+	if(!exists(number) || rules[number].state == RULE_STATE_UNKNOWN)
+		return 0;
+
+	const uint8_t* code = rules[number].code;
+
+	memcpy(&slotID,code,sizeof(slotID));
+	dataType = code[2];
+
+	int32_t value;
+	memcpy(&value,code + (rules[number].state ? 3 : 7),sizeof(value));
+
+	if(value == RULE_VALUE_NONE)
+		return 0;
+
+	return AnyData::fromNumber(static_cast<DataType>(dataType),value,dest);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,138 @@
+#pragma once
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <Arduino.h>
+#include "../config.h"
+#include "../utils/vector.h"
+#include <stddef.h>
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#if RULES_MAX_COUNT > 32
+	#error "RULES_MAX_COUNT must be <= 32"
+#endif
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+	Правила: "если условие над значениями слотов выполняется - записать в целевой слот одно значение, иначе - другое".
+
+	Код правила (хранится и передаётся как есть, до RULE_MAX_LENGTH байт):
+		ID целевого слота, 2 байта
+		тип данных целевого слота (DataType), 1 байт
+		значение, когда условие выполняется, 4 байта
+		значение, когда условие не выполняется, 4 байта
+		условие - байт-код стековой машины, до конца кода правила
+
+	Все значения - целые числа (см. AnyData::toNumber): температура, влажность и влажность почвы - в сотых долях.
+	Значение RULE_VALUE_NONE - "ничего не писать": так делаются блокировки, которые только запрещают, но ничего не разрешают.
+
+	Байт-код условия (RuleOp): Slot и Number кладут число на стек, сравнения снимают два числа и кладут 1 или 0,
+	And и Or снимают два, Not - одно. В конце на стеке должно остаться ровно одно число - результат условия.
+	Код проверяется целиком при установке правила, поэтому при вычислении стек не переполняется и не пустеет.
+
+	Правило вычисляется заново только тогда, когда пришли данные одного из слотов его условия: индекс зависимостей
+	"ID слота -> номер правила" отсортирован по ID слота и ищется двоичным поиском.
+
+	Пропали данные слота из условия (сброшены или протухли) - правило считается невыполненным (см. slotLost()),
+	поэтому безопасное для оборудования значение пишется в "значение, когда условие не выполняется".
+*/
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define RULE_HEADER_SIZE 11 // ID целевого слота, тип данных, два значения
+#define RULE_STATE_UNKNOWN 0xFF // правило ещё ни разу не удалось вычислить
+#define RULE_VALUE_NONE int32_t(0x80000000) // значение правила "в целевой слот ничего не писать"
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+enum class RuleOp : uint8_t
+{
+	Slot, // + ID слота (2 байта): значение слота
+	Number, // + число со знаком (4 байта)
+	Greater,
+	GreaterOrEqual,
+	Less,
+	LessOrEqual,
+	Equal,
+	NotEqual,
+	And,
+	Or,
+	Not,
+};
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// откуда правила берут значения слотов
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+class RuleInputs
+{
+	public:
+		virtual ~RuleInputs() {}
+		
+		// false - значения слота нет, правило с ним сейчас не вычислить
+		virtual bool getSlotValue(uint16_t slotID, int32_t& result) = 0;
+};
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+	uint16_t slotID;
+	uint8_t rule;
+
+} RuleDependency;
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+typedef Vector<RuleDependency> RuleDependenciesList;
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+class RuleEngine
+{
+	public:
+		RuleEngine(RuleInputs& inputs);
+		~RuleEngine();
+
+		// проверяет код правила целиком: заголовок, тип целевого слота и то, что стек условия сходится к одному числу
+		static bool validate(const uint8_t* code, uint8_t length);
+
+		// перебирает ID слотов условия по порядку: pos - откуда продолжать (0 - с начала), false - слотов больше нет
+		static bool nextConditionSlot(const uint8_t* code, uint8_t length, uint8_t& pos, uint16_t& slotID);
+
+		// ставит правило под номером number (0..RULES_MAX_COUNT-1) взамен прежнего, false - код правила неверен
+		bool set(uint8_t number, const uint8_t* code, uint8_t length);
+		bool remove(uint8_t number);
+
+		bool exists(uint8_t number) { return number < RULES_MAX_COUNT && rules[number].code; }
+		uint8_t getCount();
+		const uint8_t* getCode(uint8_t number) { return rules[number].code; }
+		uint8_t getLength(uint8_t number) { return rules[number].length; }
+		uint8_t getState(uint8_t number) { return rules[number].state; } // 1, 0 или RULE_STATE_UNKNOWN
+		uint16_t getTarget(uint8_t number); // ID целевого слота правила
+
+		// есть ли правила, которые зависят от слота
+		bool dependsOn(uint16_t slotID) { size_t pos = findDependency(slotID); return pos < dependencies.size() && dependencies[pos].slotID == slotID; }
+
+		// пришли данные слота - правила, которые от него зависят, будут вычислены при следующем update()
+		void slotChanged(uint16_t slotID);
+
+		// данных слота больше нет - правила, которые от него зависят, переходят в результат "условие не выполняется",
+		// его значение и считается безопасным. Возвращает битовую маску правил, у которых поменялся результат
+		uint32_t slotLost(uint16_t slotID);
+
+		// вычисляет помеченные правила, возвращает битовую маску правил, у которых поменялся результат
+		uint32_t update();
+
+		// что правило пишет в целевой слот при текущем результате; возвращает длину данных, 0 - писать нечего
+		uint16_t getOutput(uint8_t number, uint16_t& slotID, uint8_t& dataType, uint8_t* dest);
+
+	private:
+
+		typedef struct
+		{
+			uint8_t* code;
+			uint8_t length;
+			uint8_t state;
+
+		} Rule;
+
+		RuleInputs* inputs;
+		Rule rules[RULES_MAX_COUNT];
+		uint32_t dirty; // битовая маска правил, ждущих вычисления
+
+		RuleDependenciesList dependencies; // отсортированы по ID слота
+		void addDependency(uint16_t slotID, uint8_t rule);
+		void removeDependencies(uint8_t rule);
+		size_t findDependency(uint16_t slotID); // первая зависимость с ID слота не меньше slotID
+
+		bool evaluate(uint8_t number, bool& result);
+
+		RuleEngine(const RuleEngine& rhs);
+		RuleEngine& operator=(const RuleEngine& rhs);
+};
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,149 @@
+#include "cachedstorage.h"
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+CachedStorage::CachedStorage(_Storage& s)
+{
+	backend = &s;
+	nextVictim = 0;
+	
+	for(uint8_t i=0;i<STORAGE_CACHE_LINES;i++)
+	{
+		lines[i].valid = false;
+		lines[i].dirty = 0;
+	}
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+CachedStorage::~CachedStorage()
+{
+	flush();
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void CachedStorage::init(uint16_t baseAddress)
+{
+	// адреса меняются - всё, что накоплено, дописываем по старым адресам
+	flush();
+	
+	for(uint8_t i=0;i<STORAGE_CACHE_LINES;i++)
+		lines[i].valid = false;
+	
+	backend->init(baseAddress);
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+StorageCacheLine* CachedStorage::getLine(uint16_t address)
+{
+	uint16_t lineAddress = address - (address % STORAGE_CACHE_LINE_SIZE);
+	
+	for(uint8_t i=0;i<STORAGE_CACHE_LINES;i++)
+	{
+		if(lines[i].valid && lines[i].address == lineAddress)
+			return &(lines[i]);
+	}
+	
+	// промах - вытесняем строку по кругу, но сначала ищем пустую или чистую: её можно занять, ничего не записывая.
+	// Незаписанные байты есть во всех строках - тогда байты вытесняемой строки дописываем сейчас
+	uint8_t victim = nextVictim;
+	for(uint8_t k=0;k<STORAGE_CACHE_LINES;k++)
+	{
+		uint8_t i = (nextVictim + k) % STORAGE_CACHE_LINES;
+		
+		if(!lines[i].valid || !lines[i].dirty)
+		{
+			victim = i;
+			break;
+		}
+	}
+	
+	StorageCacheLine* line = &(lines[victim]);
+	nextVictim = (victim + 1) % STORAGE_CACHE_LINES;
+	
+	flushLine(line);
+	
+	line->address = lineAddress;
+	line->valid = true;
+	backend->readBlock(lineAddress,line->data,STORAGE_CACHE_LINE_SIZE);
+	
+	return line;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void CachedStorage::flushLine(StorageCacheLine* line)
+{
+	if(!line->valid || !line->dirty)
+		return;
+	
+	for(uint8_t i=0;i<STORAGE_CACHE_LINE_SIZE;i++)
+	{
+		if(line->dirty & (1 << i))
+			backend->write(line->address + i,line->data[i]);
+	}
+	
+	line->dirty = 0;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint8_t CachedStorage::read(uint16_t address)
+{
+	return getLine(address)->data[address % STORAGE_CACHE_LINE_SIZE];
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void CachedStorage::write(uint16_t address, uint8_t val)
+{
+	StorageCacheLine* line = getLine(address);
+	uint8_t offset = address % STORAGE_CACHE_LINE_SIZE;
+	
+	if(line->data[offset] == val)
+		return; // не изменилось - писать нечего
+	
+	line->data[offset] = val;
+	line->dirty |= (1 << offset);
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void CachedStorage::update()
+{
+	backend->update();
+	
+	if(!backend->ready())
+		return; // предыдущая запись ещё идёт
+	
+	// дописываем один байт за вызов: запись байта EEPROM - это ~3.3 мс, пусть они идут в фоне, а не разом
+	for(uint8_t i=0;i<STORAGE_CACHE_LINES;i++)
+	{
+		StorageCacheLine* line = &(lines[i]);
+		
+		if(!line->valid || !line->dirty)
+			continue;
+		
+		for(uint8_t k=0;k<STORAGE_CACHE_LINE_SIZE;k++)
+		{
+			uint16_t bit = (1 << k);
+			if(line->dirty & bit)
+			{
+				backend->write(line->address + k,line->data[k]);
+				line->dirty &= ~bit;
+				return;
+			}
+		}
+	}
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void CachedStorage::flush()
+{
+	for(uint8_t i=0;i<STORAGE_CACHE_LINES;i++)
+		flushLine(&(lines[i]));
+	
+	backend->flush();
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint16_t CachedStorage::getDirtyCount()
+{
+	uint16_t result = 0;
+	
+	for(uint8_t i=0;i<STORAGE_CACHE_LINES;i++)
+	{
+		for(uint8_t k=0;k<STORAGE_CACHE_LINE_SIZE;k++)
+		{
+			if(lines[i].valid && (lines[i].dirty & (1 << k)))
+				result++;
+		}
+	}
+	
+	return result;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,49 @@
+#pragma once
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "storage.h"
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#if STORAGE_CACHE_LINE_SIZE > 16
+	#error "STORAGE_CACHE_LINE_SIZE must be <= 16: dirty bytes are tracked by a 16-bit mask"
+#endif
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+	uint16_t address; // адрес первого байта строки в хранилище
+	uint16_t dirty; // битовая маска изменённых, но ещё не записанных байт строки
+	bool valid;
+	uint8_t data[STORAGE_CACHE_LINE_SIZE];
+	
+} StorageCacheLine;
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// RAM-кэш с отложенной записью поверх любого хранилища: запись в него мгновенная, а изменённые байты
+// дописываются в хранилище по одному за вызов update(), пока хранилище готово к записи, - цикл не стоит на записи в EEPROM.
+// Байты, значение которых не изменилось, не пишутся вовсе.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+class CachedStorage : public _Storage
+{
+	public:
+	
+		CachedStorage(_Storage& s);
+		~CachedStorage();
+		
+		void init(uint16_t baseAddress);
+		uint8_t read(uint16_t address);
+		void write(uint16_t address, uint8_t val);
+		void updateBlock(uint16_t address, const uint8_t* src, uint16_t length) { writeBlock(address,src,length); } // запись и так пропускает неизменившиеся байты
+		
+		bool ready() { return backend->ready(); }
+		void update();
+		void flush();
+		
+		uint16_t getDirtyCount(); // сколько байт ждут записи
+		
+	private:
+	
+		StorageCacheLine* getLine(uint16_t address);
+		void flushLine(StorageCacheLine* line);
+	
+		_Storage* backend;
+		StorageCacheLine lines[STORAGE_CACHE_LINES];
+		uint8_t nextVictim; // какую строку вытесняем следующей
+};
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
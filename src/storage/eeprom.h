@@ -15,6 +15,24 @@ class Storage : public _Storage
 	uint8_t read(uint16_t address) { return EEPROM.read(baseAddress + address); }
 	void write(uint16_t address,uint8_t val) { EEPROM.write(baseAddress + address,val); }
 	
+	void readBlock(uint16_t address, uint8_t* dest, uint16_t length)
+	{
+		address += baseAddress;
+		while(length--)
+			*dest++ = EEPROM.read(address++);
+	}
+	
+	void updateBlock(uint16_t address, const uint8_t* src, uint16_t length)
+	{
+		address += baseAddress;
+		while(length--)
+			EEPROM.update(address++,*src++); // EEPROM.update сам пропускает неизменившиеся ячейки
+	}
+	
+	#ifdef __AVR__
+	bool ready() { return eeprom_is_ready(); }
+	#endif
+	
 	private:
 		uint16_t baseAddress;
 };
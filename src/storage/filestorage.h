@@ -0,0 +1,230 @@
+#pragma once
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// хранилища поверх файла - ТОЛЬКО ДЛЯ СБОРКИ НА КОМПЬЮТЕРЕ (Linux и т.п.), для прогонов контроллера и модулей без железа:
+// каждый виртуальный узел хранит свои данные в своём файле, и они переживают перезапуск.
+// Новый файл заполняется байтами 0xFF - как чистая EEPROM.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#ifndef ARDUINO
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "storage.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <errno.h>
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// открывает файл хранилища, при необходимости создаёт и дописывает до нужного размера байтами 0xFF
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+inline int openStorageFile(const char* fileName, uint32_t size)
+{
+	int fd = open(fileName, O_RDWR | O_CREAT, 0644);
+	if(fd < 0)
+		return fd;
+
+	struct stat st;
+	if(fstat(fd,&st) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	uint8_t empty[256];
+	memset(empty,0xFF,sizeof(empty));
+
+	for(off_t pos = st.st_size; pos < off_t(size); )
+	{
+		size_t toWrite = size_t(size - pos) > sizeof(empty) ? sizeof(empty) : size_t(size - pos);
+		ssize_t written = pwrite(fd,empty,toWrite,pos);
+
+		if(written <= 0)
+		{
+			close(fd);
+			return -1;
+		}
+
+		pos += written;
+	}
+
+	return fd;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// хранилище в файле, чтение и запись - через pread/pwrite
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+class FileStorage : public _Storage
+{
+	public:
+
+	// sync == true - flush() дожидается записи на диск (fdatasync), иначе данные переживают перезапуск процесса, но не системы
+	FileStorage(const char* fileName, uint32_t size = 4096, bool sync = false)
+	{
+		baseAddress = 0;
+		storageSize = size;
+		syncOnFlush = sync;
+		failed = false;
+		fd = openStorageFile(fileName,size);
+	}
+
+	~FileStorage()
+	{
+		if(fd >= 0)
+			close(fd);
+	}
+
+	bool isOpen() { return fd >= 0; }
+
+	// была ли хоть одна неудачная запись или синхронизация с диском с момента открытия
+	bool hasErrors() { return failed; }
+
+	void init(uint16_t _baseAddress) { baseAddress = _baseAddress; }
+
+	uint8_t read(uint16_t address)
+	{
+		uint8_t b = 0xFF;
+		readBlock(address,&b,1);
+		return b;
+	}
+
+	void write(uint16_t address, uint8_t val) { writeBlock(address,&val,1); }
+
+	void readBlock(uint16_t address, uint8_t* dest, uint16_t length)
+	{
+		if(fd < 0 || pread(fd,dest,length,off_t(baseAddress) + address) != ssize_t(length))
+			memset(dest,0xFF,length);
+	}
+
+	void writeBlock(uint16_t address, const uint8_t* src, uint16_t length)
+	{
+		if(fd < 0 || uint32_t(baseAddress) + address + length > storageSize)
+		{
+			failed = true;
+			return;
+		}
+
+		// pwrite может записать меньше, чем просили, - дописываем остаток
+		for(uint16_t done = 0; done < length; )
+		{
+			ssize_t written = pwrite(fd,src + done,length - done,off_t(baseAddress) + address + done);
+
+			if(written < 0 && errno == EINTR)
+				continue;
+
+			if(written <= 0)
+			{
+				failed = true;
+				return;
+			}
+
+			done += written;
+		}
+	}
+
+	// у файла нет ресурса на перезапись - сравнивать с записанным незачем
+	void updateBlock(uint16_t address, const uint8_t* src, uint16_t length) { writeBlock(address,src,length); }
+
+	void flush()
+	{
+		if(fd >= 0 && syncOnFlush && fdatasync(fd) != 0)
+			failed = true;
+	}
+
+	private:
+		int fd;
+		uint16_t baseAddress;
+		uint32_t storageSize;
+		bool syncOnFlush;
+		bool failed;
+};
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// хранилище в отображённом в память файле: чтение и запись - просто обращения к памяти, самый дешёвый вариант для сотни узлов
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+class MmapStorage : public _Storage
+{
+	public:
+
+	// sync == true - flush() дожидается записи на диск (msync с MS_SYNC), иначе только ставит её в очередь ядра
+	MmapStorage(const char* fileName, uint32_t size = 4096, bool sync = false)
+	{
+		baseAddress = 0;
+		storageSize = size;
+		syncOnFlush = sync;
+		failed = false;
+		memory = NULL;
+
+		int fd = openStorageFile(fileName,size);
+		if(fd < 0)
+			return;
+
+		void* mapped = mmap(NULL,size,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+		close(fd); // отображение живёт и без дескриптора
+
+		if(mapped != MAP_FAILED)
+			memory = (uint8_t*) mapped;
+	}
+
+	~MmapStorage()
+	{
+		if(memory)
+			munmap(memory,storageSize);
+	}
+
+	bool isOpen() { return memory != NULL; }
+
+	// была ли хоть одна запись за пределы хранилища или неудачная синхронизация с диском с момента открытия
+	bool hasErrors() { return failed; }
+
+	void init(uint16_t _baseAddress) { baseAddress = _baseAddress; }
+
+	uint8_t read(uint16_t address)
+	{
+		uint32_t pos = uint32_t(baseAddress) + address;
+		return (memory && pos < storageSize) ? memory[pos] : 0xFF;
+	}
+
+	void write(uint16_t address, uint8_t val)
+	{
+		uint32_t pos = uint32_t(baseAddress) + address;
+		if(memory && pos < storageSize)
+			memory[pos] = val;
+		else
+			failed = true;
+	}
+
+	void readBlock(uint16_t address, uint8_t* dest, uint16_t length)
+	{
+		uint32_t pos = uint32_t(baseAddress) + address;
+
+		if(memory && pos + length <= storageSize)
+			memcpy(dest,memory + pos,length);
+		else
+			memset(dest,0xFF,length);
+	}
+
+	void writeBlock(uint16_t address, const uint8_t* src, uint16_t length)
+	{
+		uint32_t pos = uint32_t(baseAddress) + address;
+
+		if(memory && pos + length <= storageSize)
+			memcpy(memory + pos,src,length);
+		else
+			failed = true;
+	}
+
+	void updateBlock(uint16_t address, const uint8_t* src, uint16_t length) { writeBlock(address,src,length); }
+
+	void flush()
+	{
+		if(memory && msync(memory,storageSize,syncOnFlush ? MS_SYNC : MS_ASYNC) != 0)
+			failed = true;
+	}
+
+	private:
+		uint8_t* memory;
+		uint16_t baseAddress;
+		uint32_t storageSize;
+		bool syncOnFlush;
+		bool failed;
+};
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#endif // ARDUINO
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
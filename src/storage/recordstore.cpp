@@ -0,0 +1,424 @@
+#include "recordstore.h"
+#include "../utils/crc8.h"
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define RECORD_STORE_END_KEY 0xFF // ключ-признак конца журнала
+#define RECORD_STORE_CHUNK 16 // кусками такого размера данные записей читаются и копируются
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+RecordStore::RecordStore(_Storage& s, uint16_t address, uint16_t size)
+{
+	storage = &s;
+	startAddress = address;
+	halfSize = size/2;
+	activeHalf = 0;
+	generation = 0;
+	writeOffset = RECORD_STORE_HEADER_SIZE;
+	keysCount = 0;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool RecordStore::readHeader(uint8_t half, uint16_t& gen)
+{
+	uint8_t header[RECORD_STORE_HEADER_SIZE];
+	storage->readBlock(halfAddress(half),header,sizeof(header));
+	
+	if(header[0] != 'R' || header[1] != 'S' || crc8(header,sizeof(header)-1) != header[sizeof(header)-1])
+		return false;
+	
+	gen = header[2] | (uint16_t(header[3]) << 8);
+	return true;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void RecordStore::writeHeader(uint8_t half, uint16_t gen)
+{
+	uint8_t header[RECORD_STORE_HEADER_SIZE] = {'R', 'S', uint8_t(gen), uint8_t(gen >> 8), 0};
+	header[sizeof(header)-1] = crc8(header,sizeof(header)-1);
+	
+	storage->updateBlock(halfAddress(half),header,sizeof(header));
+	storage->flush();
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void RecordStore::invalidateHeader(uint8_t half)
+{
+	const uint8_t empty = 0xFF;
+	storage->updateBlock(halfAddress(half),&empty,1);
+	storage->flush();
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool RecordStore::mount()
+{
+	uint16_t gen0, gen1;
+	bool valid0 = readHeader(0,gen0);
+	bool valid1 = readHeader(1,gen1);
+	
+	if(!valid0 && !valid1)
+	{
+		DBGLN(F("[STORE] No journal, format."));
+		format();
+		return false;
+	}
+	
+	if(valid0 && valid1)
+		activeHalf = (int16_t(gen1 - gen0) > 0) ? 1 : 0; // поколение может переполниться, сравниваем через разность
+	else
+		activeHalf = valid1 ? 1 : 0;
+	
+	generation = activeHalf ? gen1 : gen0;
+	
+	scan();
+	
+	DBG(F("[STORE] Mounted, generation: "));
+	DBG(generation);
+	DBG(F(", records: "));
+	DBGLN(keysCount);
+	
+	return true;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void RecordStore::format()
+{
+	// новое поколение должно отличаться от всех, что могли остаться в хранилище, иначе старые записи оживут
+	uint16_t gen0 = 0, gen1 = 0;
+	bool valid0 = readHeader(0,gen0);
+	bool valid1 = readHeader(1,gen1);
+	
+	uint16_t gen = generation;
+	if(valid0 && int16_t(gen0 - gen) > 0)
+		gen = gen0;
+	if(valid1 && int16_t(gen1 - gen) > 0)
+		gen = gen1;
+	
+	gen++;
+	
+	invalidateHeader(1);
+	
+	const uint8_t endKey = RECORD_STORE_END_KEY;
+	storage->updateBlock(halfAddress(0) + RECORD_STORE_HEADER_SIZE,&endKey,1);
+	
+	writeHeader(0,gen);
+	
+	activeHalf = 0;
+	generation = gen;
+	writeOffset = RECORD_STORE_HEADER_SIZE;
+	keysCount = 0;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint8_t RecordStore::recordCrc(uint16_t gen, uint8_t key, uint8_t length)
+{
+	uint8_t crc = crc8_update(0,uint8_t(gen));
+	crc = crc8_update(crc,uint8_t(gen >> 8));
+	crc = crc8_update(crc,key);
+	
+	return crc8_update(crc,length);
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void RecordStore::scan()
+{
+	keysCount = 0;
+	
+	uint16_t base = halfAddress(activeHalf);
+	uint16_t offset = RECORD_STORE_HEADER_SIZE;
+	
+	while(uint32_t(offset) + RECORD_STORE_RECORD_OVERHEAD <= halfSize)
+	{
+		uint8_t head[2];
+		storage->readBlock(base + offset,head,sizeof(head));
+		
+		uint8_t key = head[0];
+		uint8_t length = head[1];
+		
+		if(key == RECORD_STORE_END_KEY || uint32_t(offset) + RECORD_STORE_RECORD_OVERHEAD + length > halfSize)
+			break;
+		
+		// считаем CRC данных кусками
+		uint8_t crc = recordCrc(generation,key,length);
+		uint8_t chunk[RECORD_STORE_CHUNK];
+		uint16_t dataAddress = base + offset + sizeof(head);
+		uint8_t left = length;
+		
+		while(left)
+		{
+			uint8_t toRead = left > sizeof(chunk) ? sizeof(chunk) : left;
+			storage->readBlock(dataAddress,chunk,toRead);
+			
+			for(uint8_t i=0;i<toRead;i++)
+				crc = crc8_update(crc,chunk[i]);
+			
+			dataAddress += toRead;
+			left -= toRead;
+		}
+		
+		if(storage->read(dataAddress) != crc)
+			break; // испорченная запись - здесь журнал кончается
+		
+		if(length)
+			setKey(key,offset);
+		else
+			removeKey(key);
+		
+		offset += RECORD_STORE_RECORD_OVERHEAD + length;
+	}
+	
+	writeOffset = offset;
+	
+	// журнал должен кончаться признаком конца: на его месте следующая запись и появится
+	if(writeOffset < halfSize && storage->read(base + writeOffset) != RECORD_STORE_END_KEY)
+	{
+		const uint8_t endKey = RECORD_STORE_END_KEY;
+		storage->updateBlock(base + writeOffset,&endKey,1);
+		storage->flush();
+	}
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint8_t RecordStore::findKey(uint8_t key)
+{
+	for(uint8_t i=0;i<keysCount;i++)
+	{
+		if(keys[i] == key)
+			return i;
+	}
+	
+	return 0xFF;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void RecordStore::setKey(uint8_t key, uint16_t offset)
+{
+	uint8_t idx = findKey(key);
+	
+	if(idx == 0xFF)
+	{
+		if(keysCount >= RECORD_STORE_MAX_KEYS)
+		{
+			DBGLN(F("[STORE] Index full, record skipped!"));
+			return;
+		}
+		
+		idx = keysCount++;
+		keys[idx] = key;
+	}
+	
+	offsets[idx] = offset;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void RecordStore::removeKey(uint8_t key)
+{
+	uint8_t idx = findKey(key);
+	if(idx == 0xFF)
+		return;
+	
+	// на место удалённого ставим последний
+	keysCount--;
+	keys[idx] = keys[keysCount];
+	offsets[idx] = offsets[keysCount];
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint8_t RecordStore::getLength(uint8_t key)
+{
+	uint8_t idx = findKey(key);
+	if(idx == 0xFF)
+		return 0;
+	
+	return storage->read(halfAddress(activeHalf) + offsets[idx] + 1);
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint8_t RecordStore::read(uint8_t key, void* dest, uint8_t maxLength)
+{
+	uint8_t idx = findKey(key);
+	if(idx == 0xFF)
+		return 0;
+	
+	uint16_t address = halfAddress(activeHalf) + offsets[idx];
+	uint8_t length = storage->read(address + 1);
+	
+	if(length > maxLength)
+		length = maxLength;
+	
+	storage->readBlock(address + 2,(uint8_t*)dest,length);
+	
+	return length;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool RecordStore::sameData(uint16_t offset, const uint8_t* data, uint8_t length)
+{
+	uint16_t address = halfAddress(activeHalf) + offset;
+	
+	if(storage->read(address + 1) != length)
+		return false;
+	
+	address += 2;
+	uint8_t chunk[RECORD_STORE_CHUNK];
+	
+	while(length)
+	{
+		uint8_t toRead = length > sizeof(chunk) ? sizeof(chunk) : length;
+		storage->readBlock(address,chunk,toRead);
+		
+		if(memcmp(chunk,data,toRead))
+			return false;
+		
+		address += toRead;
+		data += toRead;
+		length -= toRead;
+	}
+	
+	return true;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void RecordStore::append(uint8_t key, const uint8_t* data, uint8_t length)
+{
+	uint16_t address = halfAddress(activeHalf) + writeOffset;
+	uint16_t nextOffset = writeOffset + RECORD_STORE_RECORD_OVERHEAD + length;
+	
+	uint8_t crc = recordCrc(generation,key,length);
+	for(uint8_t i=0;i<length;i++)
+		crc = crc8_update(crc,data[i]);
+	
+	// сначала - всё, кроме ключа: пока на месте ключа лежит признак конца журнала, запись для журнала не существует
+	storage->updateBlock(address + 1,&length,1);
+	storage->updateBlock(address + 2,data,length);
+	storage->updateBlock(address + 2 + length,&crc,1);
+	
+	// переносим признак конца журнала за новую запись
+	if(nextOffset < halfSize)
+	{
+		const uint8_t endKey = RECORD_STORE_END_KEY;
+		storage->updateBlock(halfAddress(activeHalf) + nextOffset,&endKey,1);
+	}
+	
+	storage->flush();
+	
+	// и последним байтом ставим ключ - запись появляется в журнале целиком или не появляется вовсе
+	storage->updateBlock(address,&key,1);
+	storage->flush();
+	
+	writeOffset = nextOffset;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint16_t RecordStore::copyRecord(uint16_t from, uint16_t to, uint16_t toGeneration)
+{
+	uint8_t head[2];
+	storage->readBlock(from,head,sizeof(head));
+	
+	uint8_t crc = recordCrc(toGeneration,head[0],head[1]);
+	storage->updateBlock(to,head,sizeof(head));
+	
+	from += sizeof(head);
+	to += sizeof(head);
+	
+	uint8_t chunk[RECORD_STORE_CHUNK];
+	uint8_t left = head[1];
+	
+	while(left)
+	{
+		uint8_t toCopy = left > sizeof(chunk) ? sizeof(chunk) : left;
+		storage->readBlock(from,chunk,toCopy);
+		storage->updateBlock(to,chunk,toCopy);
+		
+		for(uint8_t i=0;i<toCopy;i++)
+			crc = crc8_update(crc,chunk[i]);
+		
+		from += toCopy;
+		to += toCopy;
+		left -= toCopy;
+	}
+	
+	storage->updateBlock(to,&crc,1);
+	
+	return RECORD_STORE_RECORD_OVERHEAD + head[1];
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void RecordStore::compact(uint8_t skipKey)
+{
+	DBGLN(F("[STORE] Compact..."));
+	
+	uint8_t target = activeHalf ? 0 : 1;
+	uint16_t newGeneration = generation + 1;
+	
+	// пока новая половина не готова - она не должна считаться актуальной, даже если там осталось валидное старое поколение
+	invalidateHeader(target);
+	
+	removeKey(skipKey);
+	
+	uint16_t from = halfAddress(activeHalf);
+	uint16_t to = halfAddress(target);
+	uint16_t offset = RECORD_STORE_HEADER_SIZE;
+	
+	for(uint8_t i=0;i<keysCount;i++)
+	{
+		uint16_t recordLength = copyRecord(from + offsets[i],to + offset,newGeneration);
+		offsets[i] = offset;
+		offset += recordLength;
+	}
+	
+	if(offset < halfSize)
+	{
+		const uint8_t endKey = RECORD_STORE_END_KEY;
+		storage->updateBlock(to + offset,&endKey,1);
+	}
+	
+	// заголовок - последним: с этого момента актуальна новая половина
+	writeHeader(target,newGeneration);
+	
+	activeHalf = target;
+	generation = newGeneration;
+	writeOffset = offset;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool RecordStore::write(uint8_t key, const void* data, uint8_t length)
+{
+	if(key == RECORD_STORE_END_KEY || !length)
+		return false;
+	
+	const uint8_t* src = (const uint8_t*) data;
+	uint8_t idx = findKey(key);
+	
+	if(idx != 0xFF)
+	{
+		if(sameData(offsets[idx],src,length))
+			return true; // ничего не изменилось - ничего и не пишем
+	}
+	else if(keysCount >= RECORD_STORE_MAX_KEYS)
+	{
+		return false;
+	}
+	
+	if(!fits(length))
+	{
+		compact(0xFF); // старую версию записи не выбрасываем: если новая не влезет и после уплотнения, останется старая
+		
+		if(!fits(length))
+		{
+			DBGLN(F("[STORE] No space!"));
+			return false;
+		}
+	}
+	
+	uint16_t offset = writeOffset;
+	append(key,src,length);
+	setKey(key,offset);
+	
+	return true;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool RecordStore::remove(uint8_t key)
+{
+	if(!exists(key))
+		return true;
+	
+	if(fits(0))
+	{
+		append(key,NULL,0); // запись-надгробие
+		removeKey(key);
+	}
+	else
+	{
+		compact(key); // при уплотнении запись просто не переносится
+	}
+	
+	return true;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint16_t RecordStore::getFreeSpace()
+{
+	uint32_t used = uint32_t(writeOffset) + RECORD_STORE_RECORD_OVERHEAD;
+	return used >= halfSize ? 0 : uint16_t(halfSize - used);
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,97 @@
+#pragma once
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "storage.h"
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+	Журнальное хранилище записей "ключ -> данные" поверх любого _Storage.
+
+	Область хранилища делится на две половины, работает всегда одна из них. Новая версия записи не перезаписывает старую,
+	а дописывается в конец журнала - так запись размазывается по всем ячейкам половины, а не бьёт в одни и те же.
+	Когда место в половине кончается, актуальные версии записей переносятся в другую половину (уплотнение),
+	и работа продолжается там.
+
+	Заголовок половины (RECORD_STORE_HEADER_SIZE байт):
+		'R','S'
+		поколение, 2 байта - растёт при каждом уплотнении, актуальна половина с более новым поколением
+		CRC8 предыдущих байт заголовка
+
+	Запись:
+		ключ, 1 байт
+		длина данных, 1 байт (0 - запись удалена)
+		данные
+		CRC8 поколения половины, ключа, длины и данных
+
+	Журнал кончается байтом 0xFF на месте ключа следующей записи.
+
+	Защита от пропадания питания:
+		- запись дописывается так: длина, данные и CRC, потом признак конца журнала за ней, и последним - её ключ
+		  поверх старого признака конца. Недописанная запись в журнал просто не попадает;
+		- журнал читается до признака конца или до первой записи с неправильным CRC;
+		- в CRC записи входит поколение, поэтому старые записи, оставшиеся в половине с прошлого раза, не принимаются за новые;
+		- при уплотнении заголовок новой половины пишется последним: пока он не записан, актуальной остаётся старая половина.
+*/
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define RECORD_STORE_HEADER_SIZE 5
+#define RECORD_STORE_RECORD_OVERHEAD 3 // ключ, длина, CRC
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+class RecordStore
+{
+	public:
+	
+		// address и size - область хранилища, которую занимает журнал (обе половины)
+		RecordStore(_Storage& s, uint16_t address, uint16_t size);
+		
+		bool mount(); // находит актуальную половину и строит индекс записей, false - журнала не было, хранилище отформатировано
+		void format(); // стирает все записи
+		
+		bool write(uint8_t key, const void* data, uint8_t length); // ключ 0xFF зарезервирован; false - нет места или индекс полон
+		uint8_t read(uint8_t key, void* dest, uint8_t maxLength); // возвращает кол-во прочитанных байт, 0 - записи нет
+		bool remove(uint8_t key);
+		
+		bool exists(uint8_t key) { return findKey(key) != 0xFF; }
+		uint8_t getLength(uint8_t key);
+		
+		template<typename T>
+		bool write(uint8_t key, const T& val) { return write(key,&val,sizeof(T)); }
+		
+		template<typename T>
+		bool read(uint8_t key, T& val) { return read(key,&val,sizeof(T)) == sizeof(T); }
+		
+		uint16_t getFreeSpace(); // сколько байт ещё можно дописать в текущую половину
+		uint16_t getGeneration() { return generation; }
+		uint8_t getKeysCount() { return keysCount; }
+		
+	private:
+	
+		bool readHeader(uint8_t half, uint16_t& gen);
+		void writeHeader(uint8_t half, uint16_t gen);
+		void invalidateHeader(uint8_t half);
+		
+		void scan(); // проходит журнал текущей половины, строит индекс, находит конец журнала
+		void compact(uint8_t skipKey); // переносит актуальные записи (кроме skipKey) в другую половину
+		bool fits(uint8_t length) { return uint32_t(writeOffset) + RECORD_STORE_RECORD_OVERHEAD + length <= halfSize; }
+		uint16_t halfAddress(uint8_t half) { return startAddress + half*halfSize; }
+		void append(uint8_t key, const uint8_t* data, uint8_t length);
+		bool sameData(uint16_t offset, const uint8_t* data, uint8_t length);
+		uint16_t copyRecord(uint16_t from, uint16_t to, uint16_t toGeneration);
+		
+		uint8_t findKey(uint8_t key);
+		void setKey(uint8_t key, uint16_t offset);
+		void removeKey(uint8_t key);
+		
+		uint8_t recordCrc(uint16_t gen, uint8_t key, uint8_t length);
+		
+		_Storage* storage;
+		uint16_t startAddress;
+		uint16_t halfSize;
+		
+		uint8_t activeHalf; // 0 или 1
+		uint16_t generation;
+		uint16_t writeOffset; // куда дописывать следующую запись, относительно начала половины
+		
+		// индекс: ключ -> смещение последней версии записи в текущей половине
+		uint8_t keys[RECORD_STORE_MAX_KEYS];
+		uint16_t offsets[RECORD_STORE_MAX_KEYS];
+		uint8_t keysCount;
+};
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -7,9 +7,41 @@
 class _Storage
 {
 	public:
+		virtual ~_Storage() {}
+		
 		virtual void init(uint16_t baseAddress) = 0;
 		virtual uint8_t read(uint16_t address) = 0;
 		virtual void write(uint16_t address, uint8_t val) = 0;
+		
+		// блочные операции: по умолчанию - побайтно, реализации переопределяют их, если умеют быстрее
+		virtual void readBlock(uint16_t address, uint8_t* dest, uint16_t length)
+		{
+			while(length--)
+				*dest++ = read(address++);
+		}
+		
+		virtual void writeBlock(uint16_t address, const uint8_t* src, uint16_t length)
+		{
+			while(length--)
+				write(address++,*src++);
+		}
+		
+		// пишет только те байты, которые отличаются от уже записанных - бережёт ресурс EEPROM и время
+		virtual void updateBlock(uint16_t address, const uint8_t* src, uint16_t length)
+		{
+			while(length--)
+			{
+				if(read(address) != *src)
+					write(address,*src);
+				
+				address++;
+				src++;
+			}
+		}
+		
+		virtual bool ready() { return true; } // можно писать, не дожидаясь окончания предыдущей записи
+		virtual void update() {} // фоновая работа хранилища, вызывается из update() модуля/контроллера
+		virtual void flush() {} // дописывает всё, что ещё не записано
 };
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 class StorageReader
@@ -23,18 +55,13 @@ public:
 		if(!s)
 			return false;
 		
-        if(s->read(address++) != SETT_HEADER1)
-          return false;
-    
-        if(s->read(address++) != SETT_HEADER2)
+        uint8_t header[2];
+        s->readBlock(address,header,sizeof(header));
+        
+        if(header[0] != SETT_HEADER1 || header[1] != SETT_HEADER2)
           return false;
     
-       uint8_t* ptr = (uint8_t*)&result;
-    
-       for(size_t i=0;i<sizeof(T);i++)
-       {
-        *ptr++ = s->read(address++);
-       }
+        s->readBlock(address + sizeof(header),(uint8_t*)&result,sizeof(T));
     
       return true;      
     }
@@ -45,13 +72,11 @@ public:
 		if(!s)
 			return;
 		
-        s->write(address++,SETT_HEADER1);
-        s->write(address++,SETT_HEADER2);
-      
-        uint8_t* ptr = (uint8_t*)&val;
+        const uint8_t header[2] = {SETT_HEADER1, SETT_HEADER2};
         
-        for(size_t i=0;i<sizeof(T);i++)
-          s->write(address++,*ptr++);      
+        // неизменившиеся байты не перезаписываем
+        s->updateBlock(address,header,sizeof(header));
+        s->updateBlock(address + sizeof(header),(const uint8_t*)&val,sizeof(T));
     }
 };
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,215 @@
+#include "capture.h"
+#include "../utils/uptime.h"
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+Capture::Capture(Stream& s)
+{
+	workStream = &s;
+	lastRecordAt = 0;
+	recordsCount = 0;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Capture::begin()
+{
+	workStream->write('S');
+	workStream->write('H');
+	workStream->write('C');
+	workStream->write((uint8_t) CAPTURE_VERSION);
+
+	lastRecordAt = uptime();
+	recordsCount = 0;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Capture::writeVarint(uint32_t val)
+{
+	while(val > 0x7F)
+	{
+		workStream->write(uint8_t((val & 0x7F) | 0x80));
+		val >>= 7;
+	}
+
+	workStream->write(uint8_t(val));
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Capture::frame(uint8_t flags, const uint8_t* header, uint16_t headerLength, const uint8_t* data, uint16_t dataLength)
+{
+	uint32_t now = uptime();
+
+	workStream->write(flags);
+	writeVarint(now - lastRecordAt);
+	writeVarint(uint32_t(headerLength) + dataLength);
+
+	if(headerLength)
+		workStream->write(header,headerLength);
+
+	if(dataLength)
+		workStream->write(data,dataLength);
+
+	lastRecordAt = now;
+	recordsCount++;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+CaptureReplay::CaptureReplay(Stream& source, bool replayTransmitted)
+{
+	workStream = &source;
+	wantTransmitted = replayTransmitted;
+	sourceDone = true;
+	startedAt = 0;
+	recordAt = 0;
+	recordData = NULL;
+	recordLength = 0;
+	recordPos = 0;
+	recordsCount = 0;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+CaptureReplay::~CaptureReplay()
+{
+	delete [] recordData;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool CaptureReplay::begin()
+{
+	delete [] recordData;
+	recordData = NULL;
+	recordLength = recordPos = 0;
+	recordAt = 0;
+	recordsCount = 0;
+
+	sourceDone = !(workStream->read() == 'S' && workStream->read() == 'H' && workStream->read() == 'C' && workStream->read() == CAPTURE_VERSION);
+
+	if(sourceDone)
+	{
+		DBGLN(F("[CAPTURE] Bad capture header!"));
+		return false;
+	}
+
+	startedAt = uptime();
+	loadRecord();
+
+	return true;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool CaptureReplay::readVarint(uint32_t& val)
+{
+	val = 0;
+	uint8_t shift = 0;
+
+	while(shift < 32)
+	{
+		int b = workStream->read();
+		if(b < 0)
+			return false;
+
+		val |= uint32_t(b & 0x7F) << shift;
+
+		if(!(b & 0x80))
+			return true;
+
+		shift += 7;
+	}
+
+	return false;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool CaptureReplay::loadRecord()
+{
+	delete [] recordData;
+	recordData = NULL;
+	recordLength = recordPos = 0;
+
+	// пропускаем записи не того направления, но их время учитываем - темп воспроизведения должен совпасть с оригиналом
+	while(!sourceDone)
+	{
+		int flags = workStream->read();
+		uint32_t delta, len;
+
+		if(flags < 0 || !readVarint(delta) || !readVarint(len) || len > 0xFFFF)
+		{
+			sourceDone = true;
+			break;
+		}
+
+		recordAt += delta;
+
+		if(bool(flags & CAPTURE_FLAG_TX) != wantTransmitted)
+		{
+			// не наше направление - проматываем сырые байты
+			while(len--)
+			{
+				if(workStream->read() < 0)
+				{
+					sourceDone = true;
+					break;
+				}
+			}
+
+			continue;
+		}
+
+		recordData = new uint8_t[len ? len : 1];
+
+		if(workStream->readBytes(recordData,len) != len)
+		{
+			// захват оборван посреди записи
+			sourceDone = true;
+			delete [] recordData;
+			recordData = NULL;
+			break;
+		}
+
+		recordLength = len;
+		return true;
+	}
+
+	return false;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool CaptureReplay::ready()
+{
+	if(recordData && recordPos >= recordLength)
+	{
+		// текущую запись отдали целиком
+		recordsCount++;
+		loadRecord();
+	}
+
+	if(!recordData)
+		return false;
+
+	return (uptime() - startedAt) >= recordAt;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+int CaptureReplay::available()
+{
+	if(!ready())
+		return 0;
+
+	return recordLength - recordPos;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+int CaptureReplay::read()
+{
+	if(!ready() || recordPos >= recordLength)
+		return -1;
+
+	return recordData[recordPos++];
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+int CaptureReplay::peek()
+{
+	if(!ready() || recordPos >= recordLength)
+		return -1;
+
+	return recordData[recordPos];
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool CaptureReplay::finished()
+{
+	ready();
+	return !recordData;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t CaptureReplay::getNextRecordTime()
+{
+	return startedAt + recordAt;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
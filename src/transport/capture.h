@@ -0,0 +1,97 @@
+#pragma once
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <Arduino.h>
+#include "../config.h"
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/*
+	Формат файла захвата трафика:
+
+		'S','H','C', CAPTURE_VERSION - заголовок файла, 4 байта
+
+	далее - записи, одна на каждый фрейм, в порядке их появления на шине:
+
+		флаги, 1 байт (CAPTURE_FLAG_*)
+		время с предыдущей записи, миллисекунд, varint (7 бит на байт, старший бит - "есть продолжение")
+		длина сырых байт фрейма, varint
+		сырые байты фрейма в том виде, в каком они были на шине (заголовок + данные)
+
+	Время первой записи отсчитывается от вызова Capture::begin().
+*/
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define CAPTURE_VERSION 1
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define CAPTURE_FLAG_TX 0x01 // фрейм отослан нами, иначе - принят
+#define CAPTURE_FLAG_HEADER_CRC_OK 0x02 // CRC заголовка сошлось
+#define CAPTURE_FLAG_DATA_CRC_OK 0x04 // CRC данных сошлось
+#define CAPTURE_FLAG_TIMEOUT 0x08 // данные фрейма не дочитаны по таймауту
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// запись фреймов транспорта в поток (SD-карта, Serial, MemoryStream и т.п.)
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+class Capture
+{
+	public:
+
+		Capture(Stream& s);
+
+		void begin(); // пишет заголовок и начинает отсчёт времени
+
+		void frame(uint8_t flags, const uint8_t* header, uint16_t headerLength, const uint8_t* data, uint16_t dataLength);
+
+		uint32_t getRecordsCount() { return recordsCount; }
+
+	private:
+
+		void writeVarint(uint32_t val);
+
+		Stream* workStream;
+		uint32_t lastRecordAt;
+		uint32_t recordsCount;
+};
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// воспроизведение захвата: поток, который отдаёт сырые байты фреймов в том же темпе, в котором они были записаны.
+// Подсовывается транспорту вместо Serial, время берётся из uptime() - с VirtualClock воспроизведение идёт
+// с любой скоростью, достаточно двигать часы до getNextRecordTime().
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+class CaptureReplay : public Stream
+{
+	public:
+
+		// replayTransmitted == false - отдаются только принятые фреймы (воспроизводим то, что слышал записавший узел),
+		// true - только отосланные (воспроизводим самого записавшего узла для его собеседника)
+		CaptureReplay(Stream& source, bool replayTransmitted=false);
+		~CaptureReplay();
+
+		bool begin(); // проверяет заголовок захвата и начинает отсчёт времени, false - это не захват
+
+		int available();
+		int read();
+		int peek();
+
+		size_t write(uint8_t b) { return 1; } // всё, что транспорт пишет в ответ, выбрасываем
+		using Print::write;
+
+		bool finished(); // записи кончились и последняя отдана полностью
+		uint32_t getNextRecordTime(); // значение uptime(), начиная с которого станет доступна следующая порция байт
+
+		uint32_t getRecordsCount() { return recordsCount; } // сколько записей уже отдано
+
+	private:
+
+		bool readVarint(uint32_t& val);
+		bool loadRecord();
+		bool ready();
+
+		Stream* workStream;
+		bool wantTransmitted;
+		bool sourceDone;
+
+		uint32_t startedAt;
+		uint32_t recordAt; // время текущей записи относительно startedAt
+
+		uint8_t* recordData;
+		uint16_t recordLength;
+		uint16_t recordPos;
+
+		uint32_t recordsCount;
+};
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
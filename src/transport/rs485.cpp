@@ -5,10 +5,35 @@
 #include <stddef.h>
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 RS485::RS485(Stream& s, uint8_t _dePin,uint32_t tmout)
+{
+	init(s,_dePin,tmout);
+	
+	// свой кольцевой буфер: в него поток выбирается на каждом update, даже пока принятый фрейм не забрали
+	ownRingBuffer = new uint8_t[RS485_RX_RING_SIZE];
+	rxRing = new RxRing(ownRingBuffer,RS485_RX_RING_SIZE);
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+RS485::RS485(RxRing& rx, Stream& s, uint8_t _dePin,uint32_t tmout)
+{
+	init(s,_dePin,tmout);
+	rxRing = &rx;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void RS485::init(Stream& s, uint8_t _dePin,uint32_t tmout)
 {
 	dePin = _dePin;
 	workStream = &s;
+	rxRing = NULL;
+	ownRingBuffer = NULL;
+	rxChunkLength = rxChunkPos = 0;
+	capture = NULL;
+	receiveState = RS485ReceiveState::WaitSTX1;
+	inSync = true;
 	writePtr = 0;
+	headerCandidate = 0;
+	crc = 0;
+	dataReaded = 0;
+	lastByteAt = 0;
 	rsPacketPtr = (uint8_t*) &rs485Packet;
 	dataBuffer = NULL;
 	receivedDataLength = 0;
@@ -19,6 +44,12 @@ RS485::RS485(Stream& s, uint8_t _dePin,uint32_t tmout)
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 RS485::~RS485()
 {
+	if(ownRingBuffer)
+	{
+		delete rxRing;
+		delete [] ownRingBuffer;
+	}
+	
 	delete [] dataBuffer;
 	wipe();
 }
@@ -55,6 +86,12 @@ bool RS485::write(const uint8_t* data, uint16_t dataLength)
 
 	workStream->write(p,sizeof(RS485Packet));
 	workStream->write(data,dataLength);
+	
+	stats.framesTx++;
+	stats.bytesTx += sizeof(RS485Packet) + dataLength;
+	
+	if(capture)
+		capture->frame(CAPTURE_FLAG_TX | CAPTURE_FLAG_HEADER_CRC_OK | CAPTURE_FLAG_DATA_CRC_OK, p, sizeof(RS485Packet), data, dataLength);
 
 	waitTransmitComplete();
 
@@ -72,168 +109,225 @@ void RS485::waitTransmitComplete()
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void RS485::update()
 {
-	while(workStream->available())
+	// поток выбираем в свой буфер целиком: пока принятый фрейм не забрали, байты копятся там, а не теряются
+	// при переполнении маленького буфера Serial. Внешний буфер наполняется из прерывания сам
+	if(ownRingBuffer)
+		rxRing->fill(*workStream);
+	
+	// забираем из кольцевого буфера кусками, а не по байту. Пока принятый фрейм не забрали - следующие
+	// не разбираем, их байты спокойно ждут в буфере: при долгих паузах цикла в буфере может накопиться несколько фреймов
+	while(!available())
 	{
-	  rsPacketPtr[writePtr++] = (uint8_t) workStream->read();
-		   
-	  if(gotRS485Packet())
-	  {
-		if(processRS485Packet())
+		if(rxChunkPos >= rxChunkLength)
 		{
-			// получили пакет, копируем данные пакета к себе
-			receivedDataLength = rs485Packet.dataLength;
-			delete [] receivedData;
-			receivedData = dataBuffer;
-			dataBuffer = NULL;
+			rxChunkPos = 0;
+			rxChunkLength = rxRing->read(rxChunk,sizeof(rxChunk));
+			
+			if(!rxChunkLength)
+				break;
+			
+			stats.bytesRx += rxChunkLength;
 		}
-	  }
-	} // while 
+		
+		processByte(rxChunk[rxChunkPos++]);
+	}
+	
+	stats.rxOverflows += rxRing->takeOverflows();
+	
+	// фрейм начал приниматься, но байты перестали поступать - бросаем его
+	if((receiveState == RS485ReceiveState::Header || receiveState == RS485ReceiveState::Data) && (uptime() - lastByteAt > receiveTimeout))
+	{
+		DBGLN(F("RS485: RECEIVE TIMEOUT!!!"));
+		stats.timeouts++;
+		
+		if(receiveState == RS485ReceiveState::Data)
+		{
+			frameDone(true);
+		}
+		else
+		{
+			lostSync();
+			receiveState = RS485ReceiveState::WaitSTX1;
+		}
+	}
   
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-bool RS485::gotRS485Packet()
+void RS485::lostSync()
 {
-  // проверяем, есть ли у нас полный RS-485 пакет
-  if(writePtr > ( sizeof(RS485Packet)-1 ))
-  {
-      // вычитали N байт из потока, надо проверить - не пакет ли это?
-      if(!(rs485Packet.stx1 == STX1 && rs485Packet.stx2 == STX2))
-      {
-         // заголовок неправильный, ищем возможное начало пакета
-         uint8_t readPtr = 0;
-         bool startPacketFound = false;
-         while(readPtr < sizeof(RS485Packet))
-         {
-           if(rsPacketPtr[readPtr] == STX1)
-           {
-            startPacketFound = true;
-            break;
-           }
-            readPtr++;
-         } // while
-    
-         if(!startPacketFound) // не нашли начало пакета
-         {
-            writePtr = 0; // сбрасываем указатель чтения и выходим
-            return false;
-         }
-    
-         if(readPtr == 0)
-         {
-          // стартовый байт заголовка найден, но он в нулевой позиции, следовательно - что-то пошло не так
-            writePtr = 0; // сбрасываем указатель чтения и выходим
-            return false;       
-         } // if
-    
-         // начало пакета найдено, копируем всё, что после него, перемещая в начало буфера
-         
-         uint8_t thisWritePtr = 0;
-         uint8_t bytesWritten = 0;
-         while(readPtr < sizeof(RS485Packet) )
-         {
-          rsPacketPtr[thisWritePtr++] = rsPacketPtr[readPtr++];
-          bytesWritten++;
-         }
-
-    
-         writePtr = bytesWritten; // запоминаем, куда писать следующий байт
-
-         return false;
-             
-      } // if
-      else
-      {
-        // заголовок совпал, проверяем жопку
-        if(!(rs485Packet.etx1 == ETX1 && rs485Packet.etx2 == ETX2))
-        {
-          // окончание неправильное, сбрасываем указатель чтения и выходим
-          writePtr = 0;
-          return false;
-        }
-  
-        // жопка совпала, проверяем CRC пакета
-        // данные мы получили, сразу обнуляем указатель записи, чтобы не забыть
-        writePtr = 0;
-    
-        // проверяем контрольную сумму
-        uint8_t crc = crc8(rsPacketPtr,sizeof(RS485Packet) - 1);
-        if(crc != rs485Packet.packetCrc)
-        {
-          // не сошлось, игнорируем
-          DBGLN(F("RS485: BAD PACKET CRC!!!"));
-          return false;
-        }
-        
-        // CRC сошлось, пакет валидный
-        return true;              
-      } // else
-  } // if
-  
-  return false;
+	// выбрасываем байты - значит, ищем начало фрейма в мусоре. Считаем один раз на каждый кусок мусора
+	if(inSync)
+	{
+		stats.resyncs++;
+		inSync = false;
+	}
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-bool RS485::processRS485Packet()
+void RS485::processByte(uint8_t b)
 {
-   bool receiveResult = false;
-   
-    // у нас в пакете лежит длина данных, надо их вычитать из потока
-   // DBG(F("RS485: DATA TO READ: "));
-   // DBGLN(rs485Packet.dataLength);
-
-    uint16_t readed = 0;
-    delete [] dataBuffer;
-    dataBuffer = new uint8_t[rs485Packet.dataLength];
-    memset(dataBuffer,0,rs485Packet.dataLength);
-    
-    uint32_t startReadingTime = uptime();
-    bool hasTimeout = false;
-    
-    while(readed < rs485Packet.dataLength)
-    {
-      while(workStream->available() && readed < rs485Packet.dataLength)
-      {
-        dataBuffer[readed++] = workStream->read();
-        startReadingTime = uptime();
-      }
-
-      if(uptime() - startReadingTime > receiveTimeout) // таймаут чтения
-      {
-        DBGLN(F("RS485: RECEIVE TIMEOUT!!!"));
-        hasTimeout = true;
-        break;
-      }
-    } // while
-
-    bool isCrcGood = false;
-    
-    if(rs485Packet.dataLength)
-    {
-        uint8_t dataCrc = crc8(dataBuffer,rs485Packet.dataLength);
-        
-        if(dataCrc == rs485Packet.dataCrc)
-        {
-          isCrcGood = true;
-		  /*
-          DBG(F("RS485: DATA RECEIVED = "));
-          #ifdef _DEBUG
-            DEBUG_SERIAL.write(dataBuffer,rs485Packet.dataLength);
-            DEBUG_SERIAL.println();
-          #endif        
-		  */
-        }
-        else
-        {
-          DBGLN(F("RS485: BAD DATA CRC!!!"));
-        }
-    } // if(rs485Packet.dataLength)
-    else
-    {
-      isCrcGood = true; // нет данных в пакете 
-    }
-
-   receiveResult = isCrcGood && !hasTimeout;
-        
-  return receiveResult;
+	switch(receiveState)
+	{
+		case RS485ReceiveState::WaitSTX1:
+		{
+			if(b == STX1)
+				receiveState = RS485ReceiveState::WaitSTX2;
+			else
+				lostSync();
+		}
+		break; // WaitSTX1
+		
+		case RS485ReceiveState::WaitSTX2:
+		{
+			if(b == STX2)
+			{
+				// начало фрейма найдено, принимаем заголовок
+				rs485Packet.stx1 = STX1;
+				rs485Packet.stx2 = STX2;
+				writePtr = 2;
+				headerCandidate = 0;
+				crc = crc8_update(crc8_update(0,STX1),STX2);
+				lastByteAt = uptime();
+				
+				receiveState = RS485ReceiveState::Header;
+			}
+			else
+			{
+				// предыдущий STX1 оказался мусором. Но если пришёл ещё один STX1 - настоящий фрейм может начинаться с него,
+				// поэтому продолжаем ждать STX2, не теряя ни байта
+				lostSync();
+				
+				if(b != STX1)
+					receiveState = RS485ReceiveState::WaitSTX1;
+			}
+		}
+		break; // WaitSTX2
+		
+		case RS485ReceiveState::Header:
+		{
+			lastByteAt = uptime();
+			
+			// попутно запоминаем, не начинается ли внутри заголовка ещё один фрейм - пригодится, если заголовок окажется мусором
+			if(!headerCandidate && writePtr > 2 && rsPacketPtr[writePtr-1] == STX1 && b == STX2)
+				headerCandidate = writePtr-1;
+			
+			rsPacketPtr[writePtr++] = b;
+			
+			// окончание заголовка проверяем сразу, не дожидаясь его конца
+			if( (writePtr == offsetof(RS485Packet,etx1)+1 && b != ETX1) || (writePtr == offsetof(RS485Packet,etx2)+1 && b != ETX2) )
+			{
+				headerFailed();
+				break;
+			}
+			
+			if(writePtr < sizeof(RS485Packet))
+			{
+				crc = crc8_update(crc,b);
+				break;
+			}
+			
+			// заголовок принят целиком, последний его байт - CRC
+			if(crc != rs485Packet.packetCrc)
+			{
+				// не сошлось, игнорируем
+				DBGLN(F("RS485: BAD PACKET CRC!!!"));
+				stats.packetCrcErrors++;
+				
+				if(capture)
+					capture->frame(0, rsPacketPtr, sizeof(RS485Packet), NULL, 0);
+				
+				headerFailed();
+				break;
+			}
+			
+			// CRC сошлось, заголовок валидный, принимаем данные
+			inSync = true;
+			crc = 0;
+			dataReaded = 0;
+			
+			delete [] dataBuffer;
+			dataBuffer = NULL;
+			
+			if(!rs485Packet.dataLength)
+			{
+				frameDone(false); // нет данных в пакете
+				break;
+			}
+			
+			dataBuffer = new uint8_t[rs485Packet.dataLength];
+			receiveState = RS485ReceiveState::Data;
+		}
+		break; // Header
+		
+		case RS485ReceiveState::Data:
+		{
+			lastByteAt = uptime();
+			
+			dataBuffer[dataReaded++] = b;
+			crc = crc8_update(crc,b);
+			
+			if(dataReaded == rs485Packet.dataLength)
+				frameDone(false);
+		}
+		break; // Data
+		
+	} // switch
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void RS485::headerFailed()
+{
+	lostSync();
+	receiveState = RS485ReceiveState::WaitSTX1;
+	
+	if(headerCandidate)
+	{
+		// внутри отвергнутого заголовка есть пара STX1 STX2 - прогоняем байты, начиная с неё, через разбор ещё раз.
+		// Это не более 6 байт и только при ошибке заголовка, остальные байты разбираются строго один раз
+		uint8_t tail[sizeof(RS485Packet)];
+		uint8_t tailLength = writePtr - headerCandidate;
+		memcpy(tail,rsPacketPtr + headerCandidate,tailLength);
+		
+		for(uint8_t i=0;i<tailLength;i++)
+			processByte(tail[i]);
+	}
+	else if(rsPacketPtr[writePtr-1] == STX1)
+	{
+		// последний байт заголовка может оказаться началом настоящего фрейма
+		receiveState = RS485ReceiveState::WaitSTX2;
+	}
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void RS485::frameDone(bool hasTimeout)
+{
+	receiveState = RS485ReceiveState::WaitSTX1;
+	
+	bool isCrcGood = !hasTimeout && (crc == rs485Packet.dataCrc);
+	
+	if(!hasTimeout && !isCrcGood)
+	{
+		DBGLN(F("RS485: BAD DATA CRC!!!"));
+		stats.dataCrcErrors++;
+	}
+	
+	if(capture)
+	{
+		uint8_t flags = CAPTURE_FLAG_HEADER_CRC_OK;
+		if(isCrcGood)
+			flags |= CAPTURE_FLAG_DATA_CRC_OK;
+		if(hasTimeout)
+			flags |= CAPTURE_FLAG_TIMEOUT;
+		
+		capture->frame(flags, rsPacketPtr, sizeof(RS485Packet), dataBuffer, dataReaded);
+	}
+	
+	if(!isCrcGood)
+		return;
+	
+	// получили пакет, копируем данные пакета к себе
+	receivedDataLength = rs485Packet.dataLength;
+	delete [] receivedData;
+	receivedData = dataBuffer;
+	dataBuffer = NULL;
+	stats.framesRx++;
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 bool RS485::available()
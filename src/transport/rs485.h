@@ -1,9 +1,15 @@
 #pragma once
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 #include "transport.h"
+#include "capture.h"
+#include "rxring.h"
 #include <Arduino.h>
 #include "../config.h"
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#if (RS485_RX_RING_SIZE & (RS485_RX_RING_SIZE - 1)) || RS485_RX_RING_SIZE > 0x8000
+	#error "RS485_RX_RING_SIZE must be a power of two"
+#endif
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 #pragma pack(push,1)
 struct RS485Packet
 {
@@ -31,11 +37,25 @@ struct RS485Packet
 };
 #pragma pack(pop)
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// состояние приёмника
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+enum class RS485ReceiveState
+{
+	WaitSTX1, // ищем первый байт начала фрейма
+	WaitSTX2, // первый байт найден, ждём второй
+	Header, // принимаем остаток заголовка
+	Data // принимаем данные фрейма
+};
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 class RS485 : public Transport
 {
 	public:
 	
+		// приём через свой кольцевой буфер на RS485_RX_RING_SIZE байт, который выбирается из потока s на каждом update
 		RS485(Stream& s, uint8_t dePin,uint32_t tmout);
+		
+		// приём идёт из кольцевого буфера, который наполняется из прерывания, передача - через поток s
+		RS485(RxRing& rx, Stream& s, uint8_t dePin,uint32_t tmout);
 		~RS485();
 	
 		void begin();
@@ -46,23 +66,40 @@ class RS485 : public Transport
 		void update();
 		uint32_t getReadingTimeout() { return receiveTimeout; }
 		
+		// запись всех фреймов (и принятых, и отосланных) в захват, NULL - выключить запись
+		void setCapture(Capture* c) { capture = c; }
+		
 		
 private:
 
     void waitTransmitComplete();
-    bool gotRS485Packet();
-    bool processRS485Packet();
     void switchToSend();
     void switchToReceive();
 
- 
-    RS485Packet getDataReceived(uint8_t* &data);
+    // разбор входящего потока: каждый байт обрабатывается по мере поступления
+    void processByte(uint8_t b);
+    void headerFailed();
+    void frameDone(bool hasTimeout);
+    void lostSync();
+    void init(Stream& s, uint8_t dePin,uint32_t tmout);
 
 	
     uint8_t dePin;
     Stream* workStream;
+    RxRing* rxRing;
+    uint8_t* ownRingBuffer; // буфер своего кольца, если внешнее кольцо не передано
+    uint8_t rxChunk[RS485_RX_CHUNK]; // кусок, забранный из кольцевого буфера
+    uint8_t rxChunkLength, rxChunkPos;
+    Capture* capture;
 
-    uint8_t writePtr;
+    RS485ReceiveState receiveState;
+    bool inSync; // false - ищем начало фрейма в мусоре
+    uint8_t writePtr; // сколько байт заголовка принято
+    uint8_t headerCandidate; // позиция в заголовке, с которой начинается ещё одна пара STX1 STX2, 0 - её нет
+    uint8_t crc; // CRC, считаемое по мере приёма
+    uint16_t dataReaded; // сколько байт данных фрейма принято
+    uint32_t lastByteAt; // когда приняли последний байт фрейма
+    
     RS485Packet rs485Packet;
     uint8_t* rsPacketPtr;
     uint32_t receiveTimeout;
@@ -0,0 +1,94 @@
+#include "rxring.h"
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+RxRing::RxRing(uint8_t* buff, uint16_t buffSize)
+{
+	buffer = buff;
+	mask = buffSize - 1;
+	head = tail = 0;
+	overflows = 0;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool RxRing::push(uint8_t b)
+{
+	uint16_t next = (head + 1) & mask;
+	
+	if(next == tail)
+	{
+		// буфер полон - теряем новый байт, старые не трогаем: их, возможно, уже разбирают
+		if(overflows < 0xFFFF)
+			overflows++;
+		
+		return false;
+	}
+	
+	buffer[head] = b;
+	head = next;
+	
+	return true;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void RxRing::fill(Stream& s)
+{
+	while(s.available())
+	{
+		push((uint8_t) s.read());
+	}
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint16_t RxRing::available()
+{
+	// 16-битные переменные на AVR читаются не атомарно
+	noInterrupts();
+	uint16_t h = head;
+	interrupts();
+	
+	return (h - tail) & mask;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint16_t RxRing::read(uint8_t* dest, uint16_t maxLength)
+{
+	noInterrupts();
+	uint16_t h = head;
+	interrupts();
+	
+	uint16_t t = tail;
+	uint16_t readed = 0;
+	
+	// копируем максимум двумя кусками: до конца буфера и с его начала
+	while(readed < maxLength && t != h)
+	{
+		uint16_t chunk = (h > t ? h : (mask + 1)) - t;
+		if(chunk > maxLength - readed)
+			chunk = maxLength - readed;
+		
+		memcpy(dest + readed, buffer + t, chunk);
+		readed += chunk;
+		t = (t + chunk) & mask;
+	}
+	
+	// отдаём место прерыванию одной записью
+	noInterrupts();
+	tail = t;
+	interrupts();
+	
+	return readed;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint16_t RxRing::takeOverflows()
+{
+	noInterrupts();
+	uint16_t result = overflows;
+	overflows = 0;
+	interrupts();
+	
+	return result;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void RxRing::clear()
+{
+	noInterrupts();
+	tail = head;
+	overflows = 0;
+	interrupts();
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
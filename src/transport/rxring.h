@@ -0,0 +1,33 @@
+#pragma once
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <Arduino.h>
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// кольцевой буфер приёма, безопасный для заполнения из прерывания. Один писатель (прерывание) - один читатель (loop).
+// Размер буфера - обязательно степень двойки, буфер выделяет вызывающая сторона.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+class RxRing
+{
+	public:
+
+		RxRing(uint8_t* buff, uint16_t buffSize);
+
+		// ВЫЗЫВАЮТСЯ ИЗ ПРЕРЫВАНИЯ (или при запрещённых прерываниях)
+		bool push(uint8_t b); // false - буфер полон, байт потерян
+		void fill(Stream& s); // забирает в буфер всё, что накопилось в потоке
+
+		// ВЫЗЫВАЮТСЯ ИЗ ОСНОВНОГО ЦИКЛА
+		uint16_t available();
+		uint16_t read(uint8_t* dest, uint16_t maxLength); // забирает из буфера до maxLength байт разом, возвращает, сколько забрано
+		uint16_t takeOverflows(); // сколько байт потеряно из-за переполнения с прошлого вызова
+		void clear();
+
+	private:
+
+		uint8_t* buffer;
+		uint16_t mask;
+
+		volatile uint16_t head; // куда пишет прерывание
+		volatile uint16_t tail; // откуда читает основной цикл
+		volatile uint16_t overflows;
+};
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,62 @@
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "tdma.h"
+#include "../utils/uptime.h"
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+TDMASchedule::TDMASchedule()
+{
+	reset();
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void TDMASchedule::reset()
+{
+	frameStart = 0;
+	frameLength = 0;
+	slotDuration = 0;
+	slot = TDMA_NO_SLOT;
+	active = false;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void TDMASchedule::sync(uint32_t beaconAt, uint16_t _slotDuration, uint8_t modulesCount, uint8_t mySlot)
+{
+	frameStart = beaconAt;
+	slotDuration = _slotDuration;
+	frameLength = uint32_t(slotDuration)*(uint32_t(modulesCount) + 1);
+	slot = mySlot;
+	active = (frameLength > 0);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool TDMASchedule::synced()
+{
+	if(!active)
+		return false;
+	
+	// если маяков давно не было - расписание протухло, контроллер, скорее всего, занят сканированием или перезапущен
+	if(uptime() - frameStart >= frameLength*TDMA_BEACON_LOST_FRAMES)
+	{
+		DBGLN(F("[TDMA] beacon lost, schedule reset."));
+		reset();
+		return false;
+	}
+	
+	return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool TDMASchedule::canTransmit()
+{
+	if(!synced())
+		return true; // расписания нет - работаем по старинке, отвечая сразу
+	
+	if(slot == TDMA_NO_SLOT)
+		return false; // расписание есть, но нам слота не досталось - молчим
+	
+	// позиция внутри текущего кадра; кадры следуют друг за другом и без новых маяков
+	uint32_t pos = (uptime() - frameStart) % frameLength;
+	uint32_t windowStart = uint32_t(slot)*slotDuration;
+	uint32_t windowEnd = windowStart + slotDuration;
+	
+	if(slotDuration > TDMA_GUARD_TIME)
+		windowEnd -= TDMA_GUARD_TIME;
+	
+	return (pos >= windowStart && pos < windowEnd);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,45 @@
+#pragma once
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <inttypes.h>
+#include "../core.h"
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define TDMA_NO_SLOT 0xFF // слот в расписании не назначен
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// расписание доступа к шине с разделением по времени (TDMA).
+// кадр начинается с маяка контроллера и состоит из (кол-во модулей + 1) слотов одинаковой длительности,
+// нулевой слот принадлежит контроллеру, остальные - модулям в порядке их следования в маяке.
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+class TDMASchedule
+{
+	public:
+		TDMASchedule();
+		
+		// сбрасывает расписание, после этого передача разрешена в любой момент
+		void reset();
+		
+		// синхронизируется с маяком, принятым (или отправленным) в момент beaconAt
+		void sync(uint32_t beaconAt, uint16_t slotDuration, uint8_t modulesCount, uint8_t mySlot);
+		
+		// есть ли актуальное расписание?
+		bool synced();
+		
+		// можно ли передавать в эфир прямо сейчас?
+		bool canTransmit();
+		
+		// длительность кадра расписания, миллисекунд
+		uint32_t getFrameLength() { return frameLength; }
+		
+		// когда начался текущий кадр
+		uint32_t getFrameStart() { return frameStart; }
+		
+		uint8_t getSlot() { return slot; }
+		
+	private:
+	
+		uint32_t frameStart;
+		uint32_t frameLength;
+		uint16_t slotDuration;
+		uint8_t slot;
+		bool active;
+};
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
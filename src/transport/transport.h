@@ -3,6 +3,48 @@
 #include <inttypes.h>
 #include "../core.h"
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// статистика работы транспорта
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+struct TransportStats
+{
+	uint32_t framesRx; // принято валидных фреймов
+	uint32_t framesTx; // отослано фреймов
+	uint32_t bytesRx; // принято байт (включая мусор)
+	uint32_t bytesTx; // отослано байт
+	uint32_t resyncs; // сколько раз искали начало фрейма из-за неправильного заголовка
+	uint32_t packetCrcErrors; // ошибки CRC заголовка фрейма
+	uint32_t dataCrcErrors; // ошибки CRC данных фрейма
+	uint32_t timeouts; // таймауты приёма данных фрейма
+	uint32_t queueOverflows; // выброшено фреймов из-за переполнения исходящих очередей
+	uint32_t rxOverflows; // потеряно принятых байт из-за переполнения буфера приёма
+	
+	// гистограмма времени "запрос -> ответ": корзина N содержит ответы, пришедшие за [2^(N-1), 2^N) миллисекунд,
+	// нулевая корзина - ответы быстрее миллисекунды, последняя - всё, что медленнее
+	uint16_t latency[STATS_LATENCY_BUCKETS];
+	
+	TransportStats() { reset(); }
+	
+	void reset()
+	{
+		framesRx = framesTx = bytesRx = bytesTx = 0;
+		resyncs = packetCrcErrors = dataCrcErrors = timeouts = queueOverflows = rxOverflows = 0;
+		memset(latency,0,sizeof(latency));
+	}
+	
+	void addLatency(uint32_t ms)
+	{
+		uint8_t bucket = 0;
+		while(ms && bucket < STATS_LATENCY_BUCKETS-1)
+		{
+			ms >>= 1;
+			bucket++;
+		}
+		
+		if(latency[bucket] < 0xFFFF)
+			latency[bucket]++;
+	}
+};
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 class Transport
 {
 	public:
@@ -13,6 +55,12 @@ class Transport
 		virtual void update() = 0; // обновляет транспорт
 		virtual void wipe() = 0; // очищает принятые данные пакета
 		virtual uint32_t getReadingTimeout() = 0; // возвращает таймаут поступления входящих данных
+		
+		TransportStats& getStats() { return stats; } // возвращает статистику работы транспорта
+		
+	protected:
+	
+		TransportStats stats;
 	
 };
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,68 @@
+#pragma once
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <Arduino.h>
+#include "../utils/uptime.h"
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// имитация линии связи: отдаёт байты из потока-источника не быстрее, чем их передал бы UART на заданной скорости.
+// Время берётся из uptime(), поэтому с VirtualClock линия работает в виртуальном времени. Подсовывается транспорту
+// вместо Serial - для стендов и нагрузочных прогонов без железа.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+class VirtualLine : public Stream
+{
+	public:
+
+		VirtualLine(Stream& s, uint32_t baudRate)
+		{
+			source = &s;
+			bytesPerSecond = baudRate/10; // старт + 8 бит данных + стоп
+			restart();
+		}
+
+		// начать отсчёт времени передачи заново, уже выданные байты не возвращаются
+		void restart()
+		{
+			startedAt = uptimeMicros();
+			delivered = 0;
+		}
+
+		int available()
+		{
+			uint32_t onLine = uint32_t((uint64_t(uptimeMicros() - startedAt)*bytesPerSecond)/1000000ull);
+			if(onLine <= delivered)
+				return 0;
+
+			int avail = source->available();
+			if(uint32_t(avail) > onLine - delivered)
+				avail = int(onLine - delivered);
+
+			return avail;
+		}
+
+		int read()
+		{
+			if(!available())
+				return -1;
+
+			delivered++;
+			return source->read();
+		}
+
+		int peek()
+		{
+			if(!available())
+				return -1;
+
+			return source->peek();
+		}
+
+		size_t write(uint8_t b) { return source->write(b); }
+		using Print::write;
+
+	private:
+
+		Stream* source;
+		uint32_t bytesPerSecond;
+		uint32_t startedAt;
+		uint32_t delivered;
+};
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,9 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "allocations.h"
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#ifdef COUNT_ALLOCATIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t allocationsCount = 0;
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#endif // COUNT_ALLOCATIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
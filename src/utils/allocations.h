@@ -0,0 +1,25 @@
+#pragma once
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <inttypes.h>
+#include "../config.h"
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// учёт выделений памяти слоя сообщений: с COUNT_ALLOCATIONS каждое выделение увеличивает allocationsCount
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#ifdef COUNT_ALLOCATIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+extern uint32_t allocationsCount; // сбрасывается тем, кто считает (например, бенчмарком)
+inline void countAllocation() { allocationsCount++; }
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#else
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+inline void countAllocation() {}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#endif // COUNT_ALLOCATIONS
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// выделение буфера с учётом
+inline uint8_t* allocateBuffer(uint16_t length)
+{
+	countAllocation();
+	return new uint8_t[length];
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
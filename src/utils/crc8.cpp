@@ -1,12 +1,8 @@
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 #include "crc8.h"
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-uint8_t crc8(const uint8_t *addr, uint16_t len)
+uint8_t crc8_update(uint8_t crc, uint8_t inbyte)
 {
-  uint8_t crc = 0;
-  while (len--) 
-    {
-    uint8_t inbyte = *addr++;
     for (uint8_t i = 8; i; i--)
       {
       uint8_t mix = (crc ^ inbyte) & 0x01;
@@ -15,6 +11,15 @@ uint8_t crc8(const uint8_t *addr, uint16_t len)
         crc ^= 0x8C;
       inbyte >>= 1;
       }  // end of for
+  return crc;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint8_t crc8(const uint8_t *addr, uint16_t len)
+{
+  uint8_t crc = 0;
+  while (len--) 
+    {
+    crc = crc8_update(crc, *addr++);
     }  // end of while
   return crc;  
 }
@@ -3,4 +3,5 @@
 #include <inttypes.h>
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 extern uint8_t crc8(const uint8_t *addr, uint16_t len);
+extern uint8_t crc8_update(uint8_t crc, uint8_t inbyte); // добавляет к CRC один байт - для подсчёта по мере поступления данных
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
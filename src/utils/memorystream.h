@@ -0,0 +1,47 @@
+#pragma once
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <Arduino.h>
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// поток поверх буфера в памяти: пишем в конец, читаем с начала. Буфер выделяет вызывающая сторона,
+// при заполнении буфера запись просто перестаёт приниматься. Годится для захвата трафика в RAM и для его воспроизведения.
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+class MemoryStream : public Stream
+{
+	public:
+
+		MemoryStream(uint8_t* buff, size_t buffSize, size_t dataLength=0)
+		{
+			buffer = buff;
+			size = buffSize;
+			writePos = dataLength > buffSize ? buffSize : dataLength;
+			readPos = 0;
+		}
+
+		int available() { return int(writePos - readPos); }
+		int read() { return readPos < writePos ? buffer[readPos++] : -1; }
+		int peek() { return readPos < writePos ? buffer[readPos] : -1; }
+
+		size_t write(uint8_t b)
+		{
+			if(writePos >= size)
+				return 0;
+
+			buffer[writePos++] = b;
+			return 1;
+		}
+
+		using Print::write;
+
+		void rewind() { readPos = 0; } // начать чтение сначала
+		void clear() { readPos = writePos = 0; } // выбросить все данные
+
+		size_t length() { return writePos; } // сколько байт записано в буфер
+		const uint8_t* getBuffer() { return buffer; }
+
+	private:
+
+		uint8_t* buffer;
+		size_t size;
+		size_t readPos, writePos;
+};
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
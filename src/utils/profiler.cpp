@@ -0,0 +1,99 @@
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include "profiler.h"
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#ifdef USE_PROFILER
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+const char PROFILE_CONTROLLER_UPDATE[] PROGMEM = "C_UPDATE";
+const char PROFILE_CONTROLLER_COMMANDS[] PROGMEM = "C_COMMANDS";
+const char PROFILE_CONTROLLER_TRANSPORTS[] PROGMEM = "C_TRANSPORTS";
+const char PROFILE_CONTROLLER_SCAN[] PROGMEM = "C_SCAN";
+const char PROFILE_CONTROLLER_ASK_SLOTS[] PROGMEM = "C_ASK_SLOTS";
+const char PROFILE_CONTROLLER_NORMAL[] PROGMEM = "C_NORMAL";
+const char PROFILE_MODULE_UPDATE[] PROGMEM = "M_UPDATE";
+const char PROFILE_MODULE_OBSERVE_SLOTS[] PROGMEM = "M_OBSERVE_SLOTS";
+const char PROFILE_MODULE_TRANSPORT[] PROGMEM = "M_TRANSPORT";
+const char PROFILE_MODULE_INCOMING[] PROGMEM = "M_INCOMING";
+const char PROFILE_MODULE_OUTGOING[] PROGMEM = "M_OUTGOING";
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// имена секций, в порядке следования в ProfileSection
+const char* const PROFILE_SECTION_NAMES[PROFILE_SECTIONS_COUNT] PROGMEM =
+{
+	PROFILE_CONTROLLER_UPDATE,
+	PROFILE_CONTROLLER_COMMANDS,
+	PROFILE_CONTROLLER_TRANSPORTS,
+	PROFILE_CONTROLLER_SCAN,
+	PROFILE_CONTROLLER_ASK_SLOTS,
+	PROFILE_CONTROLLER_NORMAL,
+	PROFILE_MODULE_UPDATE,
+	PROFILE_MODULE_OBSERVE_SLOTS,
+	PROFILE_MODULE_TRANSPORT,
+	PROFILE_MODULE_INCOMING,
+	PROFILE_MODULE_OUTGOING,
+};
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+ProfileSectionStats Profiler::sections[PROFILE_SECTIONS_COUNT];
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Profiler::add(ProfileSection section, uint32_t elapsed)
+{
+	ProfileSectionStats* st = &(sections[static_cast<uint8_t>(section)]);
+	
+	if(!st->count || elapsed < st->minTime)
+		st->minTime = elapsed;
+	
+	if(elapsed > st->maxTime)
+		st->maxTime = elapsed;
+	
+	st->count++;
+	st->totalTime += elapsed;
+	
+	uint8_t bucket = 0;
+	while(elapsed && bucket < PROFILER_HISTOGRAM_BUCKETS-1)
+	{
+		elapsed >>= 1;
+		bucket++;
+	}
+	
+	if(st->histogram[bucket] < 0xFFFF)
+		st->histogram[bucket]++;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Profiler::reset()
+{
+	memset(sections,0,sizeof(sections));
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+const char* Profiler::getName(ProfileSection section)
+{
+	return (const char*) pgm_read_ptr(&(PROFILE_SECTION_NAMES[static_cast<uint8_t>(section)]));
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Profiler::print(Stream& s, ProfileSection section)
+{
+	ProfileSectionStats* st = &(sections[static_cast<uint8_t>(section)]);
+	
+	s << (const __FlashStringHelper*) getName(section)
+		<< CORE_COMMAND_PARAM_DELIMITER << st->count
+		<< CORE_COMMAND_PARAM_DELIMITER << st->minTime
+		<< CORE_COMMAND_PARAM_DELIMITER << uint32_t(st->count ? st->totalTime/st->count : 0)
+		<< CORE_COMMAND_PARAM_DELIMITER << st->maxTime;
+	
+	for(uint8_t i=0;i<PROFILER_HISTOGRAM_BUCKETS;i++)
+	{
+		s << CORE_COMMAND_PARAM_DELIMITER << st->histogram[i];
+	}
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Profiler::dump(Stream& s)
+{
+	for(uint8_t i=0;i<PROFILE_SECTIONS_COUNT;i++)
+	{
+		if(!sections[i].count)
+			continue; // секция ни разу не выполнялась, например - модульные секции на контроллере
+		
+		print(s,static_cast<ProfileSection>(i));
+		s << ENDLINE;
+	}
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#endif // USE_PROFILER
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
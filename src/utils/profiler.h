@@ -0,0 +1,81 @@
+#pragma once
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#include <Arduino.h>
+#include "../config.h"
+#include "uptime.h"
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// секции цикла обновления, время выполнения которых замеряется профилировщиком
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+enum class ProfileSection : uint8_t
+{
+	ControllerUpdate, // SmartController::update целиком
+	ControllerCommands, // SmartController::handleIncomingCommands
+	ControllerTransports, // SmartController::updateTransports
+	ControllerScan, // SmartController::updateScan
+	ControllerAskSlots, // SmartController::updateAskSlots
+	ControllerNormal, // SmartController::updateNormal
+	ModuleUpdate, // SmartModule::update целиком
+	ModuleObserveSlots, // проверка наблюдаемых слотов в SmartModule::update
+	ModuleTransport, // обновление транспорта в SmartModule::update
+	ModuleIncoming, // SmartModule::processIncomingMessage
+	ModuleOutgoing, // SmartModule::updateOutgoing
+};
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define PROFILE_SECTIONS_COUNT (static_cast<uint8_t>(ProfileSection::ModuleOutgoing) + 1)
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#ifdef USE_PROFILER
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+typedef struct
+{
+	uint32_t count; // кол-во замеров
+	uint32_t minTime; // минимальное время выполнения, микросекунд
+	uint32_t maxTime; // максимальное время выполнения, микросекунд
+	uint64_t totalTime; // суммарное время выполнения, микросекунд
+	uint16_t histogram[PROFILER_HISTOGRAM_BUCKETS]; // корзина N - замеры длительностью [2^(N-1), 2^N) микросекунд
+	
+} ProfileSectionStats;
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+class Profiler
+{
+	public:
+	
+		static void add(ProfileSection section, uint32_t elapsed);
+		static void reset();
+		
+		static ProfileSectionStats& get(ProfileSection section) { return sections[static_cast<uint8_t>(section)]; }
+		static const char* getName(ProfileSection section); // имя секции, в PROGMEM
+		
+		// печатает статистику секции в поток, без перевода строки: section|count|min|avg|max|h0|...|hN
+		static void print(Stream& s, ProfileSection section);
+		
+		// печатает статистику всех выполнявшихся секций в поток, по строке на секцию
+		static void dump(Stream& s);
+		
+	private:
+	
+		static ProfileSectionStats sections[PROFILE_SECTIONS_COUNT];
+};
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// замер времени выполнения блока кода: от создания до выхода из области видимости
+class ProfileProbe
+{
+	public:
+		ProfileProbe(ProfileSection s) { section = s; startedAt = uptimeMicros(); }
+		~ProfileProbe() { Profiler::add(section, uptimeMicros() - startedAt); }
+		
+	private:
+		ProfileSection section;
+		uint32_t startedAt;
+};
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// имя переменной-замера склеивается с номером строки, поэтому в одном блоке можно поставить несколько замеров
+#define PROFILE_CONCAT_(a,b) a##b
+#define PROFILE_CONCAT(a,b) PROFILE_CONCAT_(a,b)
+#define PROFILE_SECTION(s) ProfileProbe PROFILE_CONCAT(profileProbe_,__LINE__)(s)
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#else
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#define PROFILE_SECTION(s) (void) 0
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+#endif // USE_PROFILER
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
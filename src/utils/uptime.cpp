@@ -1,7 +1,25 @@
 #include "uptime.h"
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+static ClockSource* clockSource = NULL;
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void setClockSource(ClockSource* source)
+{
+	clockSource = source;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 uint32_t uptime()
 {
+	if(clockSource)
+		return clockSource->getMillis();
+	
 	return millis();
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint32_t uptimeMicros()
+{
+	if(clockSource)
+		return clockSource->getMicros();
+	
+	return micros();
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -1,5 +1,41 @@
 #pragma once
 #include <Arduino.h>
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// источник времени для ядра: все таймауты ядра считаются через uptime(), поэтому, подменив источник,
+// можно гонять логику в ускоренном и полностью воспроизводимом времени
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+class ClockSource
+{
+	public:
+		virtual ~ClockSource() {}
+		virtual uint32_t getMillis() = 0; // миллисекунд с момента старта
+		virtual uint32_t getMicros() = 0; // микросекунд с момента старта
+};
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// виртуальные часы, время в которых идёт только тогда, когда его двигают руками
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+class VirtualClock : public ClockSource
+{
+	public:
+		VirtualClock() { now = 0; step = 0; }
+		
+		uint32_t getMillis() { now += step; return uint32_t(now/1000ull); }
+		uint32_t getMicros() { now += step; return uint32_t(now); }
+		
+		void set(uint32_t ms) { now = uint64_t(ms)*1000ull; } // устанавливает текущее время, миллисекунд
+		void advance(uint32_t ms) { now += uint64_t(ms)*1000ull; } // сдвигает время вперёд, миллисекунд
+		void advanceMicros(uint32_t us) { now += us; } // сдвигает время вперёд, микросекунд
+		
+		// на сколько микросекунд сдвигается время при каждом его чтении: позволяет циклам ожидания
+		// вида "while(uptime() - start < timeout)" завершаться и без внешнего сдвига времени
+		void setStep(uint32_t us) { step = us; }
+		
+	private:
+		uint64_t now; // текущее время, микросекунд
+		uint32_t step;
+};
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+extern void setClockSource(ClockSource* source); // NULL - возврат к аппаратным millis()/micros()
 extern uint32_t uptime();
+extern uint32_t uptimeMicros();
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------